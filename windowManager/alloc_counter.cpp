@@ -0,0 +1,86 @@
+#include "alloc_counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+::std::atomic<uint64_t> allocations(0);
+::std::atomic<uint64_t> frees(0);
+::std::atomic<uint64_t> allocated_bytes(0);
+thread_local uint64_t thread_allocations = 0;
+
+void* Allocate(size_t size) {
+	allocations.fetch_add(1, ::std::memory_order_relaxed);
+	allocated_bytes.fetch_add(size, ::std::memory_order_relaxed);
+	thread_allocations++;
+	// malloc(0) may return nullptr, operator new may not
+	return malloc(size != 0 ? size : 1);
+}
+
+void Free(void* p) {
+	if (p != nullptr) {
+		frees.fetch_add(1, ::std::memory_order_relaxed);
+		free(p);
+	}
+}
+
+}  // namespace
+
+AllocationTotals GetAllocationTotals() {
+	AllocationTotals totals;
+	totals.allocations = allocations.load(::std::memory_order_relaxed);
+	totals.frees = frees.load(::std::memory_order_relaxed);
+	totals.bytes = allocated_bytes.load(::std::memory_order_relaxed);
+	return totals;
+}
+
+uint64_t ThreadAllocations() {
+	return thread_allocations;
+}
+
+// the replaceable allocation functions. the aligned variants keep their
+// defaults, nothing here allocates over-aligned types
+void* operator new(size_t size) {
+	void* p = Allocate(size);
+	if (p == nullptr) {
+		throw ::std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const ::std::nothrow_t&) noexcept {
+	return Allocate(size);
+}
+
+void* operator new[](size_t size, const ::std::nothrow_t&) noexcept {
+	return Allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+	Free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	Free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	Free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	Free(p);
+}
+
+void operator delete(void* p, const ::std::nothrow_t&) noexcept {
+	Free(p);
+}
+
+void operator delete[](void* p, const ::std::nothrow_t&) noexcept {
+	Free(p);
+}
@@ -0,0 +1,22 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <cstdint>
+
+// heap allocations made through operator new, counted by the replacement
+// operators in alloc_counter.cpp. malloc() calls, like those inside Xlib,
+// aren't seen
+struct AllocationTotals {
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t bytes = 0;
+};
+
+// totals over all threads
+AllocationTotals GetAllocationTotals();
+
+// allocations made so far by the calling thread. cheap enough to read
+// around every event
+uint64_t ThreadAllocations();
+
+#endif
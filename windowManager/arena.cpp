@@ -0,0 +1,64 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace {
+
+// overflow blocks grow geometrically from this size
+const size_t kMinBlockBytes = 1024;
+const size_t kAlignment = alignof(::std::max_align_t);
+
+ArenaStats stats;
+
+size_t AlignUp(size_t n) {
+	return (n + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+}  // namespace
+
+ArenaStats GetArenaStats() {
+	return stats;
+}
+
+void* Arena::Allocate(size_t size) {
+	size = AlignUp(size);
+	if (static_cast<size_t>(end_ - cursor_) < size) {
+		// a new block, at least twice the last one
+		const size_t last = blocks_ != nullptr ? blocks_->size : kInlineBytes;
+		const size_t block_size = ::std::max(::std::max(kMinBlockBytes, last * 2), size);
+		const size_t header = AlignUp(sizeof(Block));
+		char* memory = static_cast<char*>(::operator new(header + block_size));
+		Block* block = reinterpret_cast<Block*>(memory);
+		block->next = blocks_;
+		block->size = block_size;
+		blocks_ = block;
+		cursor_ = memory + header;
+		end_ = cursor_ + block_size;
+		stats.blocks++;
+		stats.block_bytes += block_size;
+	}
+	void* p = cursor_;
+	cursor_ += size;
+	return p;
+}
+
+const char* Arena::CopyString(const char* s, size_t length) {
+	char* copy = static_cast<char*>(Allocate(length + 1));
+	memcpy(copy, s, length);
+	copy[length] = '\0';
+	stats.bytes_copied += length + 1;
+	return copy;
+}
+
+void Arena::Reset() {
+	while (blocks_ != nullptr) {
+		Block* block = blocks_;
+		blocks_ = block->next;
+		stats.blocks--;
+		stats.block_bytes -= block->size;
+		::operator delete(block);
+	}
+	cursor_ = inline_;
+	end_ = inline_ + kInlineBytes;
+}
@@ -0,0 +1,53 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// live overflow blocks of all arenas, for the heap metrics
+struct ArenaStats {
+	uint64_t blocks = 0;
+	uint64_t block_bytes = 0;
+	// bytes copied into arenas, inline or not, since startup
+	uint64_t bytes_copied = 0;
+};
+ArenaStats GetArenaStats();
+
+// a bump allocator for the variable sized data of one client, like its
+// class and title strings. the first kInlineBytes live in the arena itself,
+// so most clients never touch the heap, larger data goes to overflow
+// blocks. nothing is freed on its own: everything goes at once in Reset()
+// or when the arena is destroyed with its client, so a window lifecycle
+// leaves no holes in the heap behind.
+//
+// not thread safe, like the client records it is part of
+class Arena {
+	public:
+		static const size_t kInlineBytes = 256;
+
+		Arena() = default;
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+		~Arena() { Reset(); }
+
+		// size bytes aligned for any scalar type
+		void* Allocate(size_t size);
+		// copies the first length bytes of s and terminates them
+		const char* CopyString(const char* s, size_t length);
+		// releases everything allocated so far
+		void Reset();
+
+	private:
+		struct Block {
+			Block* next;
+			size_t size;
+		};
+
+		alignas(alignof(::std::max_align_t)) char inline_[kInlineBytes];
+		char* cursor_ = inline_;
+		char* end_ = inline_ + kInlineBytes;
+		// overflow blocks, most recent first
+		Block* blocks_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include "atoms.hpp"
+#include <glog/logging.h>
+
+namespace {
+
+const char* const kAtomNames[kAtomCount] = {
+#define PULKRAS_ATOM_NAME(id, name) name,
+	PULKRAS_ATOMS(PULKRAS_ATOM_NAME)
+#undef PULKRAS_ATOM_NAME
+};
+
+}  // namespace
+
+void Atoms::Intern(Display* display) {
+	CHECK(XInternAtoms(
+				display,
+				const_cast<char**>(kAtomNames),
+				kAtomCount,
+				False,
+				atoms_));
+}
@@ -0,0 +1,75 @@
+#ifndef ATOMS_HPP
+#define ATOMS_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+// every atom the window manager uses. they are interned once at startup in a
+// single round trip so event handlers never have to look up atom names
+#define PULKRAS_ATOMS(X) \
+	X(kNetWmWindowType, "_NET_WM_WINDOW_TYPE") \
+	X(kNetWmWindowTypeDesktop, "_NET_WM_WINDOW_TYPE_DESKTOP") \
+	X(kNetWmWindowTypeDock, "_NET_WM_WINDOW_TYPE_DOCK") \
+	X(kNetWmWindowTypeToolbar, "_NET_WM_WINDOW_TYPE_TOOLBAR") \
+	X(kNetWmWindowTypeMenu, "_NET_WM_WINDOW_TYPE_MENU") \
+	X(kNetWmWindowTypeUtility, "_NET_WM_WINDOW_TYPE_UTILITY") \
+	X(kNetWmWindowTypeSplash, "_NET_WM_WINDOW_TYPE_SPLASH") \
+	X(kNetWmWindowTypeDialog, "_NET_WM_WINDOW_TYPE_DIALOG") \
+	X(kNetWmWindowTypeDropdownMenu, "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU") \
+	X(kNetWmWindowTypePopupMenu, "_NET_WM_WINDOW_TYPE_POPUP_MENU") \
+	X(kNetWmWindowTypeTooltip, "_NET_WM_WINDOW_TYPE_TOOLTIP") \
+	X(kNetWmWindowTypeNotification, "_NET_WM_WINDOW_TYPE_NOTIFICATION") \
+	X(kNetWmWindowTypeCombo, "_NET_WM_WINDOW_TYPE_COMBO") \
+	X(kNetWmWindowTypeDnd, "_NET_WM_WINDOW_TYPE_DND") \
+	X(kNetWmWindowTypeNormal, "_NET_WM_WINDOW_TYPE_NORMAL") \
+	X(kNetWmName, "_NET_WM_NAME") \
+	X(kWmWindowRole, "WM_WINDOW_ROLE") \
+	X(kWmClientLeader, "WM_CLIENT_LEADER") \
+	X(kWmProtocols, "WM_PROTOCOLS") \
+	X(kWmDeleteWindow, "WM_DELETE_WINDOW") \
+	X(kWmTakeFocus, "WM_TAKE_FOCUS") \
+	X(kNetWmPid, "_NET_WM_PID") \
+	X(kNetWmState, "_NET_WM_STATE") \
+	X(kNetWmStateFullscreen, "_NET_WM_STATE_FULLSCREEN") \
+	X(kNetWmStateMaximizedVert, "_NET_WM_STATE_MAXIMIZED_VERT") \
+	X(kNetWmStateMaximizedHorz, "_NET_WM_STATE_MAXIMIZED_HORZ") \
+	X(kNetWmStateAbove, "_NET_WM_STATE_ABOVE") \
+	X(kNetWmStateBelow, "_NET_WM_STATE_BELOW") \
+	X(kNetWmStateHidden, "_NET_WM_STATE_HIDDEN") \
+	X(kNetWmStateSticky, "_NET_WM_STATE_STICKY") \
+	X(kNetWmStateDemandsAttention, "_NET_WM_STATE_DEMANDS_ATTENTION") \
+	X(kNetWmStateSkipTaskbar, "_NET_WM_STATE_SKIP_TASKBAR") \
+	X(kNetWmStateSkipPager, "_NET_WM_STATE_SKIP_PAGER") \
+	X(kNetWmStateModal, "_NET_WM_STATE_MODAL") \
+	X(kNetWmStateShaded, "_NET_WM_STATE_SHADED") \
+	X(kNetActiveWindow, "_NET_ACTIVE_WINDOW") \
+	X(kNetMoveResizeWindow, "_NET_MOVERESIZE_WINDOW") \
+	X(kNetCloseWindow, "_NET_CLOSE_WINDOW") \
+	X(kNetWmDesktop, "_NET_WM_DESKTOP") \
+	X(kNetCurrentDesktop, "_NET_CURRENT_DESKTOP") \
+	X(kNetNumberOfDesktops, "_NET_NUMBER_OF_DESKTOPS") \
+	X(kNetSupported, "_NET_SUPPORTED") \
+	X(kNetSupportingWmCheck, "_NET_SUPPORTING_WM_CHECK") \
+	X(kUtf8String, "UTF8_STRING") \
+	X(kManager, "MANAGER")
+
+enum AtomId {
+#define PULKRAS_ATOM_ID(id, name) id,
+	PULKRAS_ATOMS(PULKRAS_ATOM_ID)
+#undef PULKRAS_ATOM_ID
+	kAtomCount
+};
+
+class Atoms {
+	public:
+		// interns all atoms with a single XInternAtoms() call
+		void Intern(Display* display);
+
+		Atom operator[](AtomId id) const { return atoms_[id]; }
+
+	private:
+		Atom atoms_[kAtomCount] = {};
+};
+
+#endif
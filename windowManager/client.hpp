@@ -0,0 +1,160 @@
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include "arena.hpp"
+#include "frame_policy.hpp"
+#include "plugin_api.h"
+#include "window_rules.hpp"
+
+// changes queued on a client for the next batch commit
+enum DirtyFlag : uint32_t {
+	// net_state changed, apply it and rewrite _NET_WM_STATE
+	kDirtyState = 1 << 0,
+	// apply the pending geometry
+	kDirtyGeometry = 1 << 1,
+	// raise the client's group
+	kDirtyRaise = 1 << 2,
+	// apply the ConfigureRequests coalesced while the client was throttled
+	kDirtyConfigure = 1 << 3,
+};
+
+// bookkeeping for a managed top-level window. the pulkras_client part, with
+// the window, frame, geometry, workspace and net_state, is what plugins see
+struct Client : pulkras_client {
+	Client() : pulkras_client() {
+		wm_class = wm_instance = wm_role = wm_title = "";
+	}
+	Client(const Client&) = delete;
+	Client& operator=(const Client&) = delete;
+
+	// cached at MapRequest time
+	WindowTraits traits;
+	FramePolicy policy = FramePolicy::kFrameNow;
+	// owns the strings the wm_* pointers of the base point to, read at
+	// Frame() time for rule matching, and goes with the client
+	Arena arena;
+	// outcome of rule matching
+	RuleResult rules;
+	// session database key, zero if the window has no WM_CLASS
+	uint64_t session_key = 0;
+
+	// WM_TRANSIENT_FOR tree, linked intrusively through the client records
+	Client* transient_parent = nullptr;
+	Client* first_transient = nullptr;
+	Client* next_transient = nullptr;
+	Client* prev_transient = nullptr;
+	// WM_CLIENT_LEADER group, a circular list through the client records. a
+	// client without a leader is a group of its own
+	Client* group_next = nullptr;
+	Client* group_prev = nullptr;
+	// scratch for ForEachInGroup(), which marks the members of the group it
+	// walks
+	uint32_t group_mark = 0;
+	// processes stopped with FreezeGroup()
+	bool frozen = false;
+
+	// a mask of DirtyFlag
+	uint32_t dirty = 0;
+	// geometry requested by _NET_MOVERESIZE_WINDOW, fields as in XWindowChanges
+	unsigned int pending_mask = 0;
+	int pending_x = 0, pending_y = 0, pending_width = 0, pending_height = 0;
+
+	// whether fullscreen geometry is applied. while set, the frame covers
+	// the screen with no border and configure requests are not forwarded
+	bool fullscreen = false;
+	// frame geometry to restore when leaving fullscreen
+	int saved_x = 0, saved_y = 0;
+	unsigned int saved_width = 0, saved_height = 0, saved_border_width = 0;
+	// when the client was last raised, in raises. orders the clients kept
+	// above among themselves
+	uint64_t raised = 0;
+
+	// events about the client, and the X requests and handler time they cost
+	uint64_t events = 0;
+	uint64_t requests = 0;
+	uint64_t handler_ns = 0;
+	// events that arrived while the client was over its event budget, and
+	// ConfigureRequests merged into another because of it
+	uint64_t events_over_budget = 0;
+	uint64_t configures_coalesced = 0;
+	// event budget, a token bucket refilled at --client_event_rate. tokens_ns
+	// is when it was last refilled, zero for a full bucket
+	double tokens = 0;
+	uint64_t tokens_ns = 0;
+	// ConfigureRequests received over budget, merged into one for the next
+	// batch commit
+	XConfigureRequestEvent throttled_configure = {};
+};
+
+// makes child a transient of parent. refuses, returning false, when parent
+// is child or one of its transients, which would close a cycle that walks
+// up the tree never leave. child is then left a root
+inline bool AttachTransient(Client* parent, Client* child) {
+	for (const Client* ancestor = parent; ancestor != nullptr; ancestor = ancestor->transient_parent) {
+		if (ancestor == child) {
+			return false;
+		}
+	}
+	child->transient_parent = parent;
+	child->prev_transient = nullptr;
+	child->next_transient = parent->first_transient;
+	if (parent->first_transient != nullptr) {
+		parent->first_transient->prev_transient = child;
+	}
+	parent->first_transient = child;
+	// dialogs follow their parent's workspace
+	child->workspace = parent->workspace;
+	return true;
+}
+
+// calls f on client and all its transients, parents before children
+template <typename F>
+void ForEachTransient(Client* client, F& f) {
+	f(client);
+	for (Client* child = client->first_transient; child != nullptr; child = child->next_transient) {
+		ForEachTransient(child, f);
+	}
+}
+
+// a mark no client holds yet, shared by every instantiation of
+// ForEachInGroup()
+inline uint32_t NextGroupMark() {
+	static uint32_t last_mark = 0;
+	return ++last_mark;
+}
+
+// calls f on every client of the application client belongs to: the leader
+// group of its transient root and the transients of each member, parents
+// before children. each client is visited once. costs O(group size) times
+// the transient depth. f must not call ForEachInGroup()
+template <typename F>
+void ForEachInGroup(Client* client, F f) {
+	while (client->transient_parent != nullptr) {
+		client = client->transient_parent;
+	}
+	const uint32_t mark = NextGroupMark();
+	Client* member = client;
+	do {
+		member->group_mark = mark;
+		member = member->group_next;
+	} while (member != client);
+
+	do {
+		// members with an ancestor in the group are visited through it. those
+		// parented to another group's window, or not at all, are roots here
+		const Client* ancestor = member->transient_parent;
+		while (ancestor != nullptr && ancestor->group_mark != mark) {
+			ancestor = ancestor->transient_parent;
+		}
+		if (ancestor == nullptr) {
+			ForEachTransient(member, f);
+		}
+		member = member->group_next;
+	} while (member != client);
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "config.hpp"
+#include <glog/logging.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+using ::std::string;
+
+namespace {
+
+string Trim(const string& s) {
+	const size_t begin = s.find_first_not_of(" \t");
+	if (begin == string::npos) {
+		return string();
+	}
+	const size_t end = s.find_last_not_of(" \t");
+	return s.substr(begin, end - begin + 1);
+}
+
+// the largest values keys take. X caps border widths at 65535, far past
+// any sensible frame, and a window left unframed for over a minute is
+// better off framed
+const unsigned long kMaxBorderWidth = 255;
+const unsigned long kMaxColor = 0xffffff;
+const unsigned long kMaxGraceMs = 60000;
+
+// the largest value of key, false for an unknown key
+bool MaxValue(const string& key, unsigned long* max) {
+	if (key == "border_width") {
+		*max = kMaxBorderWidth;
+	} else if (key == "border_color" || key == "focused_border_color" ||
+			key == "background_color") {
+		*max = kMaxColor;
+	} else if (key == "deferred_frame_grace_ms") {
+		*max = kMaxGraceMs;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// parses decimal numbers and #rrggbb colors, the whole of value. returns
+// false, leaving out alone, on anything else, signs included
+bool ParseNumber(const string& value, unsigned long* out) {
+	const bool color = !value.empty() && value[0] == '#';
+	const char* begin = value.c_str() + (color ? 1 : 0);
+	if (!isxdigit(static_cast<unsigned char>(*begin))) {
+		return false;
+	}
+	char* end;
+	errno = 0;
+	const unsigned long number = strtoul(begin, &end, color ? 16 : 10);
+	if (*end != '\0' || errno == ERANGE) {
+		return false;
+	}
+	*out = number;
+	return true;
+}
+
+}  // namespace
+
+bool ParseConfig(const string& path, Config* config) {
+	::std::ifstream in(path);
+	if (!in) {
+		return false;
+	}
+
+	string line;
+	int line_number = 0;
+	while (::std::getline(in, line)) {
+		line_number++;
+		// '#' starts a comment only at the beginning of a line, as colors
+		// are written #rrggbb
+		const string trimmed = Trim(line);
+		if (trimmed.empty() || trimmed[0] == '#') {
+			continue;
+		}
+		const size_t eq = line.find('=');
+		if (eq == string::npos) {
+			LOG(WARNING) << path << ":" << line_number << ": expected key = value";
+			continue;
+		}
+		const string key = Trim(line.substr(0, eq));
+		const string value = Trim(line.substr(eq + 1));
+
+		unsigned long max;
+		if (!MaxValue(key, &max)) {
+			LOG(WARNING) << path << ":" << line_number << ": unknown key " << key;
+			continue;
+		}
+		unsigned long number;
+		if (!ParseNumber(value, &number)) {
+			LOG(WARNING) << path << ":" << line_number << ": bad value for " << key;
+			continue;
+		}
+		if (number > max) {
+			LOG(WARNING) << path << ":" << line_number << ": " << key << " is over " << max;
+			continue;
+		}
+		if (key == "border_width") {
+			config->border_width = number;
+		} else if (key == "border_color") {
+			config->border_color = number;
+		} else if (key == "focused_border_color") {
+			config->focused_border_color = number;
+		} else if (key == "background_color") {
+			config->background_color = number;
+		} else if (key == "deferred_frame_grace_ms") {
+			config->deferred_frame_grace_ms = number;
+		}
+	}
+	return true;
+}
+
+ConfigWatcher::~ConfigWatcher() {
+	if (thread_.joinable()) {
+		{
+			::std::lock_guard<::std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+	}
+	delete published_.exchange(nullptr);
+	if (inotify_fd_ >= 0) {
+		close(inotify_fd_);
+	}
+	if (ready_fd_ >= 0) {
+		close(ready_fd_);
+	}
+}
+
+bool ConfigWatcher::Start(const string& path) {
+	path_ = path;
+	// watch the directory, since editors replace files rather than write them
+	const size_t slash = path.rfind('/');
+	const string dir = slash == string::npos ? "." : path.substr(0, slash);
+	file_name_ = slash == string::npos ? path : path.substr(slash + 1);
+
+	inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd_ < 0) {
+		PLOG(WARNING) << "inotify_init1 failed";
+		return false;
+	}
+	if (inotify_add_watch(inotify_fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+		PLOG(WARNING) << "Failed to watch " << dir;
+		close(inotify_fd_);
+		inotify_fd_ = -1;
+		return false;
+	}
+	ready_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	CHECK_GE(ready_fd_, 0);
+	thread_ = ::std::thread(&ConfigWatcher::ParserThread, this);
+	return true;
+}
+
+void ConfigWatcher::OnInotifyReadable() {
+	alignas(inotify_event) char buffer[4096];
+	bool changed = false;
+	ssize_t length;
+	while ((length = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+		for (char* p = buffer; p < buffer + length;) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+			if (event->len > 0 && file_name_ == event->name) {
+				changed = true;
+			}
+			p += sizeof(inotify_event) + event->len;
+		}
+	}
+	if (changed) {
+		{
+			::std::lock_guard<::std::mutex> lock(mutex_);
+			reload_requested_ = true;
+		}
+		wake_.notify_one();
+	}
+}
+
+::std::unique_ptr<const Config> ConfigWatcher::TakeSnapshot() {
+	uint64_t count;
+	if (read(ready_fd_, &count, sizeof(count)) != sizeof(count)) {
+		return nullptr;
+	}
+	return ::std::unique_ptr<const Config>(published_.exchange(nullptr, ::std::memory_order_acquire));
+}
+
+void ConfigWatcher::ParserThread() {
+	for (;;) {
+		{
+			::std::unique_lock<::std::mutex> lock(mutex_);
+			wake_.wait(lock, [this] { return reload_requested_ || stopping_; });
+			if (stopping_) {
+				return;
+			}
+			reload_requested_ = false;
+		}
+
+		Config* config = new Config();
+		if (!ParseConfig(path_, config)) {
+			delete config;
+			continue;
+		}
+		// an unconsumed older snapshot is superseded
+		delete published_.exchange(config, ::std::memory_order_release);
+		const uint64_t one = 1;
+		if (write(ready_fd_, &one, sizeof(one)) != sizeof(one)) {
+			PLOG(WARNING) << "Failed to signal config reload";
+		}
+	}
+}
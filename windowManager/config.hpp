@@ -0,0 +1,71 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// user configuration. a snapshot is immutable once published, so handlers
+// read it through a plain pointer without locking
+struct Config {
+	// frame appearance
+	unsigned int border_width = 3;
+	unsigned long border_color = 0xffff00;
+	// border of the focused frame
+	unsigned long focused_border_color = 0xff8000;
+	unsigned long background_color = 0x0000ff;
+	// how long a deferred window may stay unframed
+	uint64_t deferred_frame_grace_ms = 500;
+};
+
+// parses the "key = value" lines of path into config, starting from its
+// current values. unknown keys and bad or out of range values are logged
+// and skipped
+bool ParseConfig(const ::std::string& path, Config* config);
+
+// watches the config file with inotify and parses it off the event thread.
+//
+// the event loop polls inotify_fd() and calls OnInotifyReadable(), which
+// only drains the inotify queue and wakes the parser thread. once a new
+// snapshot is parsed, ready_fd() becomes readable and TakeSnapshot() hands
+// it over. the event loop swaps it in between dispatch batches; since it is
+// the only reader, the old snapshot can be freed right after the swap
+class ConfigWatcher {
+	public:
+		ConfigWatcher() = default;
+		~ConfigWatcher();
+		ConfigWatcher(const ConfigWatcher&) = delete;
+		ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+		// starts watching path. returns false if it can't be watched
+		bool Start(const ::std::string& path);
+
+		int inotify_fd() const { return inotify_fd_; }
+		int ready_fd() const { return ready_fd_; }
+
+		void OnInotifyReadable();
+		// returns the newest parsed snapshot, or null
+		::std::unique_ptr<const Config> TakeSnapshot();
+
+	private:
+		void ParserThread();
+
+		::std::string path_;
+		::std::string file_name_;
+		int inotify_fd_ = -1;
+		// eventfd signaled when a snapshot is published
+		int ready_fd_ = -1;
+		::std::thread thread_;
+		::std::mutex mutex_;
+		::std::condition_variable wake_;
+		bool reload_requested_ = false;
+		bool stopping_ = false;
+		// published snapshot, handed over with a single exchange
+		::std::atomic<Config*> published_{nullptr};
+};
+
+#endif
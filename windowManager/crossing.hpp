@@ -0,0 +1,36 @@
+#ifndef CROSSING_HPP
+#define CROSSING_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+
+// the crossing focus follows with --focus_follows_mouse, kept until the
+// batch commit. DispatchBatch() may handle a crossing held behind a bulk
+// event for its window after a later crossing, so the crossing read last
+// wins, not the one handled last
+class PendingCrossing {
+	public:
+		// offers a crossing into window, read off the queue at queued_ns
+		void Offer(Window window, Time time, uint64_t queued_ns) {
+			if (window_ != None && queued_ns < queued_ns_) {
+				return;
+			}
+			window_ = window;
+			time_ = time;
+			queued_ns_ = queued_ns;
+		}
+		void Clear() { window_ = None; }
+
+		// None when there is no crossing to follow
+		Window window() const { return window_; }
+		Time time() const { return time_; }
+
+	private:
+		Window window_ = None;
+		Time time_ = CurrentTime;
+		uint64_t queued_ns_ = 0;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "drag.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#ifdef PULKRAS_HAVE_XI2
+extern "C" {
+#include <X11/extensions/XInput2.h>
+}
+#endif
+
+bool DragEngine::Init(Display* display, Window root, bool use_xi2) {
+	display_ = display;
+	root_ = root;
+	xi_opcode_ = -1;
+	if (!use_xi2) {
+		return false;
+	}
+#ifdef PULKRAS_HAVE_XI2
+	int opcode, first_event, first_error;
+	if (!XQueryExtension(display, "XInputExtension", &opcode, &first_event, &first_error)) {
+		LOG(WARNING) << "No XInput extension, drags use core motion";
+		return false;
+	}
+	// raw events reach the root regardless of grabs since 2.1
+	int major = 2, minor = 2;
+	if (XIQueryVersion(display, &major, &minor) != Success || major < 2 ||
+			(major == 2 && minor < 2)) {
+		LOG(WARNING) << "XInput " << major << "." << minor << " too old, drags use core motion";
+		return false;
+	}
+	xi_opcode_ = opcode;
+	LOG(INFO) << "drags use XInput " << major << "." << minor << " raw motion";
+	return true;
+#else
+	LOG(WARNING) << "Built without XInput2, drags use core motion";
+	return false;
+#endif
+}
+
+void DragEngine::Begin(DragMode mode, Window window, int root_x, int root_y,
+		int x, int y, int width, int height) {
+	mode_ = mode;
+	window_ = window;
+	press_x_ = root_x;
+	press_y_ = root_y;
+	start_x_ = x_ = x;
+	start_y_ = y_ = y;
+	start_width_ = width_ = width;
+	start_height_ = height_ = height;
+	raw_dx_ = raw_dy_ = 0;
+	if (uses_xi2()) {
+		SelectRawMotion(true);
+	}
+}
+
+bool DragEngine::OnMotion(const XMotionEvent& e) {
+	if (!active() || uses_xi2()) {
+		return false;
+	}
+	return Update(e.x_root - press_x_, e.y_root - press_y_);
+}
+
+bool DragEngine::OnGenericEvent(const XGenericEventCookie& cookie) {
+#ifdef PULKRAS_HAVE_XI2
+	if (!active() || cookie.extension != xi_opcode_ || cookie.evtype != XI_RawMotion ||
+			cookie.data == nullptr) {
+		return false;
+	}
+	// values are packed for the valuators set in the mask. 0 and 1 are x
+	// and y on pointer devices
+	const XIRawEvent* raw = static_cast<const XIRawEvent*>(cookie.data);
+	const double* value = raw->valuators.values;
+	for (int axis = 0; axis < 2 && axis < raw->valuators.mask_len * 8; axis++) {
+		if (XIMaskIsSet(raw->valuators.mask, axis)) {
+			(axis == 0 ? raw_dx_ : raw_dy_) += *value++;
+		}
+	}
+	return Update(static_cast<int>(::std::floor(raw_dx_)), static_cast<int>(::std::floor(raw_dy_)));
+#else
+	(void)cookie;
+	return false;
+#endif
+}
+
+void DragEngine::End() {
+	if (active() && uses_xi2()) {
+		SelectRawMotion(false);
+	}
+	mode_ = DragMode::kNone;
+	window_ = None;
+}
+
+bool DragEngine::Update(int dx, int dy) {
+	int x = x_, y = y_, width = width_, height = height_;
+	if (mode_ == DragMode::kMove) {
+		x = start_x_ + dx;
+		y = start_y_ + dy;
+	} else {
+		width = ::std::max(1, start_width_ + dx);
+		height = ::std::max(1, start_height_ + dy);
+	}
+	if (x == x_ && y == y_ && width == width_ && height == height_) {
+		return false;
+	}
+	x_ = x;
+	y_ = y;
+	width_ = width;
+	height_ = height;
+	return true;
+}
+
+void DragEngine::SelectRawMotion(bool enable) {
+#ifdef PULKRAS_HAVE_XI2
+	unsigned char bits[XIMaskLen(XI_RawMotion)] = {};
+	if (enable) {
+		XISetMask(bits, XI_RawMotion);
+	}
+	XIEventMask mask;
+	mask.deviceid = XIAllMasterDevices;
+	mask.mask_len = sizeof(bits);
+	mask.mask = bits;
+	XISelectEvents(display_, root_, &mask, 1);
+#else
+	(void)enable;
+#endif
+}
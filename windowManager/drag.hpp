@@ -0,0 +1,82 @@
+#ifndef DRAG_HPP
+#define DRAG_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+// XInput2 raw motion is compiled in when the libXi headers are available,
+// unless PULKRAS_NO_XI2 is defined
+#if !defined(PULKRAS_NO_XI2) && defined(__has_include)
+#if __has_include(<X11/extensions/XInput2.h>)
+#define PULKRAS_HAVE_XI2 1
+#endif
+#endif
+
+enum class DragMode {
+	kNone,
+	kMove,
+	kResize,
+};
+
+// interactive move and resize of a frame with the pointer.
+//
+// a drag starts with a press caught by the frame's drag grab, and ends with
+// the release. the position comes either from core MotionNotify, which the
+// grab reports relative to the press, or from XInput2 raw motion selected on
+// the root while the drag lasts. raw motion reports every device movement
+// with sub-pixel deltas, no matter what grabs are active or how the motion
+// is compressed, and is accumulated here so fractions add up rather than
+// being lost. it assumes a relative pointer device, like a mouse.
+//
+// the engine only tracks the geometry asked for. the window manager queues
+// it on the client, so that all motion in a batch makes one update
+class DragEngine {
+	public:
+		// with use_xi2, checks the server for XInput 2.2. returns whether raw
+		// motion is used
+		bool Init(Display* display, Window root, bool use_xi2);
+
+		bool active() const { return mode_ != DragMode::kNone; }
+		DragMode mode() const { return mode_; }
+		Window window() const { return window_; }
+		bool uses_xi2() const { return xi_opcode_ >= 0; }
+
+		// starts dragging window, whose frame is at x, y with the given size,
+		// from a press at root_x, root_y
+		void Begin(DragMode mode, Window window, int root_x, int root_y,
+				int x, int y, int width, int height);
+		// feed core motion. returns true if the geometry changed
+		bool OnMotion(const XMotionEvent& e);
+		// feed a generic event whose data was fetched. returns true if it
+		// was raw motion that changed the geometry
+		bool OnGenericEvent(const XGenericEventCookie& cookie);
+		void End();
+
+		// the geometry the drag asks for
+		int x() const { return x_; }
+		int y() const { return y_; }
+		int width() const { return width_; }
+		int height() const { return height_; }
+
+	private:
+		// applies the pointer offset dx, dy from the press
+		bool Update(int dx, int dy);
+		// selects XInput2 raw motion on the root, or clears it
+		void SelectRawMotion(bool enable);
+
+		Display* display_ = nullptr;
+		Window root_ = None;
+		// major opcode of XInputExtension, -1 without raw motion
+		int xi_opcode_ = -1;
+
+		DragMode mode_ = DragMode::kNone;
+		Window window_ = None;
+		int press_x_ = 0, press_y_ = 0;
+		int start_x_ = 0, start_y_ = 0, start_width_ = 0, start_height_ = 0;
+		// raw motion since the press, fractions included
+		double raw_dx_ = 0, raw_dy_ = 0;
+		int x_ = 0, y_ = 0, width_ = 0, height_ = 0;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "event_masks.hpp"
+
+namespace {
+
+bool Wants(uint64_t event_types, int type) {
+	return event_types & (uint64_t(1) << type);
+}
+
+}  // namespace
+
+EventMasks ComputeEventMasks(uint64_t extra_event_types, bool minimal) {
+	EventMasks masks;
+
+	// a. what the window manager itself handles. MapRequest and
+	// ConfigureRequest come from the redirect masks, UnmapNotify and
+	// DestroyNotify of framed clients from their frame
+	masks.root = SubstructureRedirectMask;
+	masks.frame = SubstructureRedirectMask | SubstructureNotifyMask;
+	masks.unframed_client = StructureNotifyMask;
+	// deferred windows are framed on the first interaction
+	masks.deferred_client = StructureNotifyMask | EnterWindowMask | FocusChangeMask;
+	if (!minimal) {
+		masks.root |= SubstructureNotifyMask;
+		masks.unframed_client = NoEventMask;
+		masks.deferred_client = EnterWindowMask | FocusChangeMask;
+	}
+
+	// b. what others want to see. pointer events are selected on frames,
+	// since only one client may select button presses on a window, and the
+	// application usually has
+	long client = NoEventMask;
+	long frame = NoEventMask;
+	if (Wants(extra_event_types, KeyPress)) {
+		client |= KeyPressMask;
+	}
+	if (Wants(extra_event_types, KeyRelease)) {
+		client |= KeyReleaseMask;
+	}
+	if (Wants(extra_event_types, ButtonPress)) {
+		frame |= ButtonPressMask;
+	}
+	if (Wants(extra_event_types, ButtonRelease)) {
+		frame |= ButtonReleaseMask;
+	}
+	if (Wants(extra_event_types, MotionNotify)) {
+		frame |= PointerMotionMask;
+	}
+	if (Wants(extra_event_types, EnterNotify)) {
+		frame |= EnterWindowMask;
+	}
+	if (Wants(extra_event_types, LeaveNotify)) {
+		frame |= LeaveWindowMask;
+	}
+	if (Wants(extra_event_types, FocusIn) || Wants(extra_event_types, FocusOut)) {
+		client |= FocusChangeMask;
+	}
+	if (Wants(extra_event_types, Expose)) {
+		frame |= ExposureMask;
+	}
+	if (Wants(extra_event_types, VisibilityNotify)) {
+		frame |= VisibilityChangeMask;
+	}
+	if (Wants(extra_event_types, PropertyNotify)) {
+		client |= PropertyChangeMask;
+	}
+	if (Wants(extra_event_types, ColormapNotify)) {
+		client |= ColormapChangeMask;
+	}
+	// new windows are only reported by the root
+	if (Wants(extra_event_types, CreateNotify)) {
+		masks.root |= SubstructureNotifyMask;
+	}
+
+	masks.frame |= frame;
+	masks.client |= client;
+	masks.unframed_client |= client;
+	masks.deferred_client |= client;
+	return masks;
+}
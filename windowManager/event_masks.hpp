@@ -0,0 +1,39 @@
+#ifndef EVENT_MASKS_HPP
+#define EVENT_MASKS_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+
+// the event masks selected on each kind of window
+struct EventMasks {
+	long root = NoEventMask;
+	long frame = NoEventMask;
+	// framed client windows
+	long client = NoEventMask;
+	// client windows left unframed by policy, and those whose framing is
+	// deferred
+	long unframed_client = NoEventMask;
+	long deferred_client = NoEventMask;
+
+	bool operator==(const EventMasks& other) const {
+		return root == other.root && frame == other.frame && client == other.client &&
+			unframed_client == other.unframed_client && deferred_client == other.deferred_client;
+	}
+	bool operator!=(const EventMasks& other) const { return !(*this == other); }
+};
+
+// derives the masks from what the enabled features handle.
+//
+// the core of it: the root only redirects, since SubstructureNotify on the
+// root would repeat, for our own frames, what each frame already reports
+// about its client. unframed clients, which have no frame to report on
+// them, select StructureNotify themselves. extra_event_types has bit n set
+// for each X event type n something else, like a plugin, wants to see.
+//
+// with minimal unset, returns the masks selected before this policy, which
+// is useful to compare event volumes
+EventMasks ComputeEventMasks(uint64_t extra_event_types, bool minimal);
+
+#endif
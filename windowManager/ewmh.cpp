@@ -0,0 +1,323 @@
+#include "ewmh.hpp"
+#include "window_manager.hpp"
+extern "C" {
+#include <X11/Xatom.h>
+}
+#include <glog/logging.h>
+#include <cstring>
+
+namespace {
+
+// _NET_WM_STATE actions
+const long kNetWmStateRemove = 0;
+const long kNetWmStateAdd = 1;
+const long kNetWmStateToggle = 2;
+
+// _NET_MOVERESIZE_WINDOW flags in data.l[0]. bits 0-7 hold the gravity,
+// which is ignored as frames have no decorations besides the border
+const long kMoveResizeX = 1 << 8;
+const long kMoveResizeY = 1 << 9;
+const long kMoveResizeWidth = 1 << 10;
+const long kMoveResizeHeight = 1 << 11;
+
+}  // namespace
+
+const AtomId kClientMessageAtoms[kClientMessageCount] = {
+	kNetActiveWindow,
+	kNetWmState,
+	kNetMoveResizeWindow,
+	kNetCloseWindow,
+	kNetWmDesktop,
+	kNetCurrentDesktop,
+};
+
+const char* const kClientMessageNames[kClientMessageCount] = {
+	"_NET_ACTIVE_WINDOW",
+	"_NET_WM_STATE",
+	"_NET_MOVERESIZE_WINDOW",
+	"_NET_CLOSE_WINDOW",
+	"_NET_WM_DESKTOP",
+	"_NET_CURRENT_DESKTOP",
+};
+
+const AtomId kNetStateAtoms[kNetStateCount] = {
+	kNetWmStateFullscreen,
+	kNetWmStateMaximizedVert,
+	kNetWmStateMaximizedHorz,
+	kNetWmStateAbove,
+	kNetWmStateBelow,
+	kNetWmStateHidden,
+	kNetWmStateSticky,
+	kNetWmStateDemandsAttention,
+	kNetWmStateSkipTaskbar,
+	kNetWmStateSkipPager,
+	kNetWmStateModal,
+	kNetWmStateShaded,
+};
+
+// plugins see net_state as is, so the bits are part of the plugin ABI
+static_assert(PULKRAS_STATE_FULLSCREEN == 1u << kStateFullscreen, "NetStateBit changed");
+static_assert(PULKRAS_STATE_MAXIMIZED_VERT == 1u << kStateMaximizedVert, "NetStateBit changed");
+static_assert(PULKRAS_STATE_MAXIMIZED_HORZ == 1u << kStateMaximizedHorz, "NetStateBit changed");
+static_assert(PULKRAS_STATE_ABOVE == 1u << kStateAbove, "NetStateBit changed");
+static_assert(PULKRAS_STATE_BELOW == 1u << kStateBelow, "NetStateBit changed");
+static_assert(PULKRAS_STATE_HIDDEN == 1u << kStateHidden, "NetStateBit changed");
+static_assert(PULKRAS_STATE_STICKY == 1u << kStateSticky, "NetStateBit changed");
+static_assert(PULKRAS_STATE_DEMANDS_ATTENTION == 1u << kStateDemandsAttention, "NetStateBit changed");
+static_assert(PULKRAS_STATE_SKIP_TASKBAR == 1u << kStateSkipTaskbar, "NetStateBit changed");
+static_assert(PULKRAS_STATE_SKIP_PAGER == 1u << kStateSkipPager, "NetStateBit changed");
+static_assert(PULKRAS_STATE_MODAL == 1u << kStateModal, "NetStateBit changed");
+static_assert(PULKRAS_STATE_SHADED == 1u << kStateShaded, "NetStateBit changed");
+static_assert(kNetStateCount == 12, "add a PULKRAS_STATE_* bit for the new state");
+
+void AtomIndex::Add(Atom atom, int index) {
+	if (atom >= table_.size()) {
+		table_.resize(atom + 1, -1);
+	}
+	table_[atom] = index;
+}
+
+const WindowManager::MessageHandler WindowManager::kMessageHandlers[kClientMessageCount] = {
+	&WindowManager::OnActiveWindowMessage,
+	&WindowManager::OnWmStateMessage,
+	&WindowManager::OnMoveResizeWindowMessage,
+	&WindowManager::OnCloseWindowMessage,
+	&WindowManager::OnWmDesktopMessage,
+	&WindowManager::OnCurrentDesktopMessage,
+};
+
+void WindowManager::SetupEwmh() {
+	// a. dispatch tables, so handling a message never looks at atom names
+	for (int i = 0; i < kClientMessageCount; i++) {
+		message_index_.Add(atoms_[kClientMessageAtoms[i]], i);
+	}
+	for (int i = 0; i < kNetStateCount; i++) {
+		state_index_.Add(atoms_[kNetStateAtoms[i]], i);
+	}
+
+	// b. _NET_SUPPORTING_WM_CHECK, on the root and on itself. the window is
+	// created by AcquireManagerSelection()
+	for (Window w : {root_, check_window_}) {
+		XChangeProperty(
+				display_,
+				w,
+				atoms_[kNetSupportingWmCheck],
+				XA_WINDOW,
+				32,
+				PropModeReplace,
+				reinterpret_cast<const unsigned char*>(&check_window_),
+				1);
+	}
+	const char kWmName[] = "pulkras";
+	XChangeProperty(
+			display_,
+			check_window_,
+			atoms_[kNetWmName],
+			atoms_[kUtf8String],
+			8,
+			PropModeReplace,
+			reinterpret_cast<const unsigned char*>(kWmName),
+			sizeof(kWmName) - 1);
+
+	// c. _NET_SUPPORTED
+	::std::vector<Atom> supported = {
+		atoms_[kNetSupportingWmCheck],
+		atoms_[kNetWmName],
+		atoms_[kNetWmWindowType],
+		atoms_[kNetNumberOfDesktops],
+	};
+	for (int i = 0; i < kClientMessageCount; i++) {
+		supported.push_back(atoms_[kClientMessageAtoms[i]]);
+	}
+	for (int i = 0; i < kNetStateCount; i++) {
+		if (kImplementedStates & (1u << i)) {
+			supported.push_back(atoms_[kNetStateAtoms[i]]);
+		}
+	}
+	XChangeProperty(
+			display_,
+			root_,
+			atoms_[kNetSupported],
+			XA_ATOM,
+			32,
+			PropModeReplace,
+			reinterpret_cast<const unsigned char*>(supported.data()),
+			supported.size());
+
+	// d. desktops, so pagers know how many workspaces there are
+	const long count = workspace_count_;
+	XChangeProperty(
+			display_,
+			root_,
+			atoms_[kNetNumberOfDesktops],
+			XA_CARDINAL,
+			32,
+			PropModeReplace,
+			reinterpret_cast<const unsigned char*>(&count),
+			1);
+}
+
+uint32_t WindowManager::ReadNetWmState(Window w) {
+	Atom actual_type;
+	int actual_format;
+	unsigned long num_items, bytes_after;
+	unsigned char* data = nullptr;
+	if (XGetWindowProperty(
+				display_,
+				w,
+				atoms_[kNetWmState],
+				0, kNetStateCount,
+				False,
+				XA_ATOM,
+				&actual_type,
+				&actual_format,
+				&num_items,
+				&bytes_after,
+				&data) != Success || data == nullptr) {
+		return 0;
+	}
+	uint32_t state = 0;
+	if (actual_type == XA_ATOM && actual_format == 32) {
+		const Atom* atoms = reinterpret_cast<Atom*>(data);
+		for (unsigned long i = 0; i < num_items; i++) {
+			const int bit = state_index_.Find(atoms[i]);
+			if (bit >= 0) {
+				state |= 1u << bit;
+			}
+		}
+	}
+	XFree(data);
+	return state;
+}
+
+void WindowManager::WriteNetWmState(Client* client) {
+	Atom atoms[kNetStateCount];
+	int num_atoms = 0;
+	for (int i = 0; i < kNetStateCount; i++) {
+		if (client->net_state & (1u << i)) {
+			atoms[num_atoms++] = atoms_[kNetStateAtoms[i]];
+		}
+	}
+	XChangeProperty(
+			display_,
+			client->window,
+			atoms_[kNetWmState],
+			XA_ATOM,
+			32,
+			PropModeReplace,
+			reinterpret_cast<const unsigned char*>(atoms),
+			num_atoms);
+}
+
+void WindowManager::WriteNetWmDesktop(Client* client) {
+	const long desktop = client->workspace;
+	XChangeProperty(
+			display_,
+			client->window,
+			atoms_[kNetWmDesktop],
+			XA_CARDINAL,
+			32,
+			PropModeReplace,
+			reinterpret_cast<const unsigned char*>(&desktop),
+			1);
+}
+
+void WindowManager::OnClientMessage(const XClientMessageEvent& e) {
+	const int type = message_index_.Find(e.message_type);
+	if (type < 0 || e.format != 32) {
+		++metrics_.client_messages_ignored;
+		return;
+	}
+	++metrics_.client_messages[type];
+
+	auto it = clients_.find(e.window);
+	Client* client = it != clients_.end() ? &it->second : nullptr;
+	(this->*kMessageHandlers[type])(client, e);
+}
+
+void WindowManager::OnActiveWindowMessage(Client* client, const XClientMessageEvent& e) {
+	if (client == nullptr) {
+		return;
+	}
+	// data.l[1] is the timestamp of the user action that caused the request
+	pending_active_ = client->window;
+	pending_active_time_ = e.data.l[1] != 0 ? static_cast<Time>(e.data.l[1]) : CurrentTime;
+}
+
+void WindowManager::OnWmStateMessage(Client* client, const XClientMessageEvent& e) {
+	if (client == nullptr) {
+		return;
+	}
+	// data.l[0] is the action, l[1] and l[2] the properties to change
+	const long action = e.data.l[0];
+	uint32_t state = client->net_state;
+	for (int i = 1; i <= 2; i++) {
+		const int bit = state_index_.Find(static_cast<Atom>(e.data.l[i]));
+		if (bit < 0) {
+			continue;
+		}
+		const uint32_t mask = 1u << bit;
+		if (action == kNetWmStateAdd) {
+			state |= mask;
+		} else if (action == kNetWmStateRemove) {
+			state &= ~mask;
+		} else if (action == kNetWmStateToggle) {
+			state ^= mask;
+		}
+	}
+	if (state == client->net_state) {
+		return;
+	}
+
+	uint32_t dirty = kDirtyState;
+	const uint32_t above = 1u << kStateAbove;
+	if ((state & above) && !(client->net_state & above)) {
+		dirty |= kDirtyRaise;
+	}
+	client->net_state = state;
+	MarkDirty(client, dirty);
+}
+
+void WindowManager::OnMoveResizeWindowMessage(Client* client, const XClientMessageEvent& e) {
+	if (client == nullptr) {
+		return;
+	}
+	const long flags = e.data.l[0];
+	if (flags & kMoveResizeX) {
+		client->pending_x = e.data.l[1];
+		client->pending_mask |= CWX;
+	}
+	if (flags & kMoveResizeY) {
+		client->pending_y = e.data.l[2];
+		client->pending_mask |= CWY;
+	}
+	if (flags & kMoveResizeWidth) {
+		client->pending_width = e.data.l[3];
+		client->pending_mask |= CWWidth;
+	}
+	if (flags & kMoveResizeHeight) {
+		client->pending_height = e.data.l[4];
+		client->pending_mask |= CWHeight;
+	}
+	if (client->pending_mask != 0) {
+		MarkDirty(client, kDirtyGeometry);
+	}
+}
+
+void WindowManager::OnCloseWindowMessage(Client* client, const XClientMessageEvent& e) {
+	if (client != nullptr) {
+		CloseClient(client);
+	}
+}
+
+void WindowManager::OnWmDesktopMessage(Client* client, const XClientMessageEvent& e) {
+	if (client != nullptr && e.data.l[0] >= 0 && e.data.l[0] < workspace_count_) {
+		MoveGroupToWorkspace(client, e.data.l[0]);
+	}
+}
+
+void WindowManager::OnCurrentDesktopMessage(Client* client, const XClientMessageEvent& e) {
+	if (e.window == root_ && e.data.l[0] >= 0 && e.data.l[0] < workspace_count_) {
+		SwitchWorkspace(e.data.l[0]);
+	}
+}
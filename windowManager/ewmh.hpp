@@ -0,0 +1,67 @@
+#ifndef EWMH_HPP
+#define EWMH_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include <vector>
+#include "atoms.hpp"
+
+// client messages handled by the window manager
+enum ClientMessageType {
+	kMessageActiveWindow,
+	kMessageWmState,
+	kMessageMoveResizeWindow,
+	kMessageCloseWindow,
+	kMessageWmDesktop,
+	kMessageCurrentDesktop,
+	kClientMessageCount
+};
+
+// message type of each ClientMessageType
+extern const AtomId kClientMessageAtoms[kClientMessageCount];
+extern const char* const kClientMessageNames[kClientMessageCount];
+
+// _NET_WM_STATE properties, as bit positions in Client::net_state
+enum NetStateBit {
+	kStateFullscreen,
+	kStateMaximizedVert,
+	kStateMaximizedHorz,
+	kStateAbove,
+	kStateBelow,
+	kStateHidden,
+	kStateSticky,
+	kStateDemandsAttention,
+	kStateSkipTaskbar,
+	kStateSkipPager,
+	kStateModal,
+	kStateShaded,
+	kNetStateCount
+};
+
+// property atom of each NetStateBit
+extern const AtomId kNetStateAtoms[kNetStateCount];
+
+// states the window manager acts on, and so advertises. the others are only
+// kept so rewriting _NET_WM_STATE doesn't drop what a client set
+const uint32_t kImplementedStates =
+	(1u << kStateFullscreen) |
+	(1u << kStateAbove);
+
+// maps atoms to small indices with a single array lookup. the server hands
+// out atoms as small sequential integers, so the table stays small
+class AtomIndex {
+	public:
+		void Add(Atom atom, int index);
+
+		// returns -1 for atoms that weren't added
+		int Find(Atom atom) const {
+			return atom < table_.size() ? table_[atom] : -1;
+		}
+
+	private:
+		::std::vector<int8_t> table_;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "flight_recorder.hpp"
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+FlightRecorder::~FlightRecorder() {
+	if (map_ != nullptr) {
+		munmap(map_, map_size_);
+	}
+}
+
+bool FlightRecorder::Open(const ::std::string& path, uint32_t capacity) {
+	static_assert(sizeof(FlightRecord) == 32, "records should pack two to a cache line");
+	static_assert(sizeof(FlightHeader) % sizeof(FlightRecord) == 0, "records should stay aligned");
+	if (capacity > kMaxCapacity) {
+		LOG(WARNING) << "Flight recorder capacity " << capacity << " is over " << kMaxCapacity;
+		return false;
+	}
+	// round up to a power of two, so the ring index is a mask
+	uint32_t rounded = 1;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	const size_t size = sizeof(FlightHeader) + static_cast<size_t>(rounded) * sizeof(FlightRecord);
+
+	// keep the last session's ring for post-mortems, and start a fresh one.
+	// a fresh file is all zeros, so an unwritten record reads as kNone
+	const ::std::string previous = path + ".prev";
+	if (rename(path.c_str(), previous.c_str()) != 0 && errno != ENOENT) {
+		PLOG(WARNING) << "Failed to keep the previous flight recorder " << path;
+	}
+	const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		PLOG(WARNING) << "Failed to open flight recorder " << path;
+		return false;
+	}
+	if (ftruncate(fd, size) != 0) {
+		PLOG(WARNING) << "Failed to size flight recorder " << path;
+		close(fd);
+		return false;
+	}
+	void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		PLOG(WARNING) << "Failed to map flight recorder " << path;
+		return false;
+	}
+
+	timespec realtime, monotonic;
+	clock_gettime(CLOCK_REALTIME, &realtime);
+	clock_gettime(CLOCK_MONOTONIC, &monotonic);
+	FlightHeader* header = static_cast<FlightHeader*>(map);
+	header->magic = kFlightMagic;
+	header->version = kFlightVersion;
+	header->record_size = sizeof(FlightRecord);
+	header->capacity = rounded;
+	header->realtime_offset_ns =
+		(static_cast<int64_t>(realtime.tv_sec) - monotonic.tv_sec) * 1000000000 +
+		(realtime.tv_nsec - monotonic.tv_nsec);
+	header->next = 0;
+
+	map_ = map;
+	map_size_ = size;
+	header_ = header;
+	records_ = reinterpret_cast<FlightRecord*>(header + 1);
+	Record(FlightKind::kStart, 0, 0, 0, getpid());
+	return true;
+}
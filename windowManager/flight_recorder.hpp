@@ -0,0 +1,105 @@
+#ifndef FLIGHT_RECORDER_HPP
+#define FLIGHT_RECORDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "util.hpp"
+
+// what a flight record stands for, and what its fields mean
+enum class FlightKind : uint16_t {
+	kNone = 0,
+	// the window manager started. value is the pid
+	kStart,
+	// an event was read. detail is its type
+	kEvent,
+	// the handlers of an event returned. value is the requests they issued
+	kHandled,
+	// a batch was flushed. value and aux are the low bits of the first and
+	// last request sequence numbers of the batch
+	kFlush,
+	// an X error. detail is the error code, value the request code
+	kXError,
+	// window was framed. value is the frame
+	kFrame,
+	// window was unframed
+	kUnframe,
+	// a CHECK failed and the process is about to abort
+	kAbort,
+};
+
+// one entry of the ring. X ids fit in 32 bits, sequence numbers are
+// truncated to their low 32 bits
+struct FlightRecord {
+	uint64_t time_ns;
+	uint32_t window;
+	uint32_t serial;
+	FlightKind kind;
+	uint16_t detail;
+	uint32_t value;
+	uint32_t aux;
+	uint32_t reserved;
+};
+
+// the start of the file, followed by capacity records
+struct FlightHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	// a power of two
+	uint32_t capacity;
+	// CLOCK_REALTIME minus CLOCK_MONOTONIC at startup, to date records
+	int64_t realtime_offset_ns;
+	// records written so far. the newest is at (next - 1) % capacity
+	uint64_t next;
+};
+
+const uint32_t kFlightMagic = 0x524c4650;  // "PFLR"
+const uint32_t kFlightVersion = 1;
+
+// an always-on binary log of the last events, handler outcomes, flushes and
+// errors, in a ring in a memory-mapped file.
+//
+// a record is a handful of stores to shared memory, so it costs next to
+// nothing per event. the pages belong to the page cache rather than to the
+// process, so they outlive a crash or an aborted CHECK, and
+// tools/flight_decode.cpp prints them. the previous session's file is kept
+// next to the new one with a .prev suffix
+class FlightRecorder {
+	public:
+		FlightRecorder() = default;
+		~FlightRecorder();
+		FlightRecorder(const FlightRecorder&) = delete;
+		FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+		// the largest ring, as capacity is rounded up to a power of two
+		static const uint32_t kMaxCapacity = uint32_t(1) << 31;
+
+		// maps a ring of at least capacity records at path. fails for a
+		// capacity above kMaxCapacity
+		bool Open(const ::std::string& path, uint32_t capacity);
+
+		void Record(FlightKind kind, uint16_t detail, unsigned long window,
+				unsigned long serial, uint32_t value = 0, uint32_t aux = 0) {
+			if (header_ == nullptr) {
+				return;
+			}
+			FlightRecord& record = records_[header_->next & (header_->capacity - 1)];
+			record.time_ns = MonotonicNs();
+			record.window = window;
+			record.serial = serial;
+			record.kind = kind;
+			record.detail = detail;
+			record.value = value;
+			record.aux = aux;
+			header_->next++;
+		}
+
+	private:
+		void* map_ = nullptr;
+		size_t map_size_ = 0;
+		FlightHeader* header_ = nullptr;
+		FlightRecord* records_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "frame_policy.hpp"
+extern "C" {
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+}
+#include <unistd.h>
+#include <cstring>
+
+WindowTraits ReadWindowTraits(Display* display, const Atoms& atoms, Window w) {
+	WindowTraits traits;
+
+	// a. _NET_WM_WINDOW_TYPE, only the first (preferred) type matters to us
+	Atom actual_type;
+	int actual_format;
+	unsigned long num_items, bytes_after;
+	unsigned char* data = nullptr;
+	if (XGetWindowProperty(
+				display,
+				w,
+				atoms[kNetWmWindowType],
+				0, 1,
+				False,
+				XA_ATOM,
+				&actual_type,
+				&actual_format,
+				&num_items,
+				&bytes_after,
+				&data) == Success && data != nullptr) {
+		if (actual_type == XA_ATOM && actual_format == 32 && num_items > 0) {
+			traits.window_type = reinterpret_cast<Atom*>(data)[0];
+		}
+		XFree(data);
+	}
+
+	// b. WM_TRANSIENT_FOR
+	Window transient_for = None;
+	if (XGetTransientForHint(display, w, &transient_for)) {
+		traits.transient_for = transient_for;
+	}
+
+	// c. WM_CLIENT_LEADER
+	data = nullptr;
+	if (XGetWindowProperty(
+				display,
+				w,
+				atoms[kWmClientLeader],
+				0, 1,
+				False,
+				XA_WINDOW,
+				&actual_type,
+				&actual_format,
+				&num_items,
+				&bytes_after,
+				&data) == Success && data != nullptr) {
+		if (actual_type == XA_WINDOW && actual_format == 32 && num_items > 0) {
+			traits.leader = reinterpret_cast<Window*>(data)[0];
+		}
+		XFree(data);
+	}
+
+	// d. WM_HINTS, for the input model and as the leader fallback
+	XWMHints* wm_hints = XGetWMHints(display, w);
+	if (wm_hints != nullptr) {
+		if (traits.leader == None && (wm_hints->flags & WindowGroupHint)) {
+			traits.leader = wm_hints->window_group;
+		}
+		if (wm_hints->flags & InputHint) {
+			traits.input = wm_hints->input;
+		}
+		XFree(wm_hints);
+	}
+
+	// e. WM_NORMAL_HINTS
+	XSizeHints hints;
+	long supplied;
+	if (XGetWMNormalHints(display, w, &hints, &supplied)) {
+		traits.fixed_size =
+			(hints.flags & PMinSize) && (hints.flags & PMaxSize) &&
+			hints.min_width == hints.max_width &&
+			hints.min_height == hints.max_height;
+	}
+
+	// f. WM_PROTOCOLS
+	Atom* protocols;
+	int num_protocols;
+	if (XGetWMProtocols(display, w, &protocols, &num_protocols)) {
+		for (int i = 0; i < num_protocols; i++) {
+			if (protocols[i] == atoms[kWmTakeFocus]) {
+				traits.take_focus = true;
+			} else if (protocols[i] == atoms[kWmDeleteWindow]) {
+				traits.delete_window = true;
+			}
+		}
+		XFree(protocols);
+	}
+
+	// g. _NET_WM_PID, only for clients on this host
+	XTextProperty machine;
+	char hostname[256] = {};
+	if (XGetWMClientMachine(display, w, &machine) &&
+			gethostname(hostname, sizeof(hostname) - 1) == 0) {
+		const bool local = machine.value != nullptr && machine.format == 8 &&
+			strcmp(reinterpret_cast<const char*>(machine.value), hostname) == 0;
+		XFree(machine.value);
+		data = nullptr;
+		if (local && XGetWindowProperty(
+					display,
+					w,
+					atoms[kNetWmPid],
+					0, 1,
+					False,
+					XA_CARDINAL,
+					&actual_type,
+					&actual_format,
+					&num_items,
+					&bytes_after,
+					&data) == Success && data != nullptr) {
+			if (actual_type == XA_CARDINAL && actual_format == 32 && num_items > 0) {
+				traits.pid = static_cast<pid_t>(reinterpret_cast<unsigned long*>(data)[0]);
+			}
+			XFree(data);
+		}
+	}
+
+	return traits;
+}
+
+FramePolicy ClassifyWindow(const Atoms& atoms, const WindowTraits& traits) {
+	const Atom type = traits.window_type;
+
+	// windows that position themselves and are never decorated
+	if (type == atoms[kNetWmWindowTypeDock] ||
+			type == atoms[kNetWmWindowTypeDesktop] ||
+			type == atoms[kNetWmWindowTypeMenu] ||
+			type == atoms[kNetWmWindowTypeDropdownMenu] ||
+			type == atoms[kNetWmWindowTypePopupMenu] ||
+			type == atoms[kNetWmWindowTypeTooltip] ||
+			type == atoms[kNetWmWindowTypeCombo] ||
+			type == atoms[kNetWmWindowTypeDnd]) {
+		return FramePolicy::kNoFrame;
+	}
+
+	// windows that are likely gone within a moment
+	if (type == atoms[kNetWmWindowTypeSplash] ||
+			type == atoms[kNetWmWindowTypeNotification]) {
+		return FramePolicy::kDefer;
+	}
+
+	// fixed size transients are mostly progress and confirmation dialogs
+	if (traits.transient_for != None && traits.fixed_size) {
+		return FramePolicy::kDefer;
+	}
+
+	return FramePolicy::kFrameNow;
+}
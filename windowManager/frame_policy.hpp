@@ -0,0 +1,65 @@
+#ifndef FRAME_POLICY_HPP
+#define FRAME_POLICY_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <sys/types.h>
+#include "atoms.hpp"
+
+// what to do with a window when it asks to be mapped
+enum class FramePolicy {
+	// frame right away, the usual case for application windows
+	kFrameNow,
+	// map unframed and frame it only if it outlives the grace period or the
+	// user interacts with it. splash screens, notifications and progress
+	// dialogs are often gone before a frame would pay off
+	kDefer,
+	// never frame. docks, desktops and menu-like windows place themselves
+	kNoFrame,
+};
+
+// properties read once at MapRequest time and cached in the client record
+struct WindowTraits {
+	Atom window_type = None;
+	Window transient_for = None;
+	// WM_CLIENT_LEADER, falling back to the WM_HINTS window group
+	Window leader = None;
+	// min size equals max size in WM_NORMAL_HINTS
+	bool fixed_size = false;
+	// the WM_HINTS input field, true when unset as most clients expect
+	bool input = true;
+	// WM_PROTOCOLS
+	bool take_focus = false;
+	bool delete_window = false;
+	// _NET_WM_PID, or 0 when unset or WM_CLIENT_MACHINE isn't this host, as
+	// a pid from another host means nothing here
+	pid_t pid = 0;
+};
+
+// reads the traits of w. costs one round trip per property
+WindowTraits ReadWindowTraits(Display* display, const Atoms& atoms, Window w);
+
+// the ICCCM input models, from the input hint and WM_TAKE_FOCUS
+enum class FocusModel {
+	// never focused
+	kNoInput,
+	// focused by the window manager
+	kPassive,
+	// focused by the window manager, and told with WM_TAKE_FOCUS
+	kLocallyActive,
+	// told with WM_TAKE_FOCUS, and focuses itself if it wants to
+	kGloballyActive,
+};
+
+inline FocusModel FocusModelOf(const WindowTraits& traits) {
+	if (traits.take_focus) {
+		return traits.input ? FocusModel::kLocallyActive : FocusModel::kGloballyActive;
+	}
+	return traits.input ? FocusModel::kPassive : FocusModel::kNoInput;
+}
+
+// picks a framing policy from cached traits, without talking to the server
+FramePolicy ClassifyWindow(const Atoms& atoms, const WindowTraits& traits);
+
+#endif
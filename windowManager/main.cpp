@@ -1,10 +1,12 @@
 #include <cstdlib> 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include "window_manager.hpp"
 
 using ::std::unique_ptr;
 
 int main(int argc, char** argv) {
+	::gflags::ParseCommandLineFlags(&argc, &argv, true);
 	::google::InitGoogleLogging(argv[0]);
 
 	unique_ptr<WindowManager> window_manager(WindowManager::Create());
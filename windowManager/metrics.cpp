@@ -0,0 +1,116 @@
+#include "metrics.hpp"
+#include <glog/logging.h>
+#include <malloc.h>
+#include "alloc_counter.hpp"
+#include "arena.hpp"
+#include "pool_allocator.hpp"
+#include "util.hpp"
+
+void Metrics::Log() const {
+	uint64_t total_events = 0;
+	for (int type = 0; type < LASTEvent; type++) {
+		if (events[type] > 0) {
+			LOG(INFO) << "events: " << EventTypeName(type) << " " << events[type];
+			total_events += events[type];
+		}
+	}
+	LOG(INFO) << "events: " << total_events << " total, " << events_unhandled << " unhandled";
+	static const char* const kClassNames[kEventClassCount] = {"critical", "bulk"};
+	for (int i = 0; i < kEventClassCount; i++) {
+		LOG(INFO) << "queue wait: " << kClassNames[i] << " " << events_by_class[i] << " events"
+			<< ", " << (events_by_class[i] ? queue_wait_ns[i] / events_by_class[i] : 0) << " ns mean"
+			<< ", " << queue_wait_max_ns[i] / 1000 << " us max";
+	}
+	LOG(INFO) << "queue wait: " << events_prioritized << " critical events dispatched ahead of bulk ones";
+	static const char* const kBucketNames[kLatencyBuckets] = {
+		"<10us", "<100us", "<1ms", "<10ms", ">=10ms"};
+	LOG(INFO) << "latency: timer wakeups " << timer_wakeups
+		<< ", " << (timer_wakeups ? timer_lateness_ns / timer_wakeups : 0) << " ns mean late"
+		<< ", " << timer_lateness_max_ns / 1000 << " us max";
+	LOG(INFO) << "latency: wake to dispatch " << wake_dispatches
+		<< ", " << (wake_dispatches ? wake_to_dispatch_ns / wake_dispatches : 0) << " ns mean"
+		<< ", " << wake_to_dispatch_max_ns / 1000 << " us max";
+	for (int i = 0; i < kLatencyBuckets; i++) {
+		LOG(INFO) << "latency: " << kBucketNames[i]
+			<< " timer " << timer_lateness_buckets[i]
+			<< ", wake to dispatch " << wake_to_dispatch_buckets[i];
+	}
+	LOG(INFO) << "adoption: " << adopt_windows << " windows"
+		<< " in " << adopt_slices << " slices"
+		<< ", " << adopt_ns / 1000000 << " ms"
+		<< ", longest pause " << adopt_max_pause_ns / 1000 << " us";
+	LOG(INFO) << "frames: created " << frames_created
+		<< ", deferred " << frames_deferred
+		<< ", avoided " << frames_avoided
+		<< ", promoted on timeout " << frames_promoted_timeout
+		<< ", promoted on interaction " << frames_promoted_interaction
+		<< ", unframed by policy " << windows_unframed;
+	LOG(INFO) << "rules: matched " << rule_matches << " windows"
+		<< " in " << rule_match_ns / 1000 << " us"
+		<< " (" << (rule_matches ? rule_match_ns / rule_matches : 0) << " ns each)"
+		<< ", " << rule_matched_windows << " with a rule applied";
+	for (int i = 0; i < kClientMessageCount; i++) {
+		LOG(INFO) << "client messages: " << kClientMessageNames[i] << " " << client_messages[i];
+	}
+	LOG(INFO) << "client messages: ignored " << client_messages_ignored;
+	LOG(INFO) << "session: hits " << session_hits
+		<< ", misses " << session_misses
+		<< ", writes " << session_writes
+		<< ", ambiguous " << session_ambiguous;
+	LOG(INFO) << "throttling: " << events_over_budget << " events over budget"
+		<< ", " << configures_coalesced << " configure requests coalesced";
+	LOG(INFO) << "focus: " << focus_crossings << " crossings"
+		<< ", " << focus_crossings_filtered << " filtered"
+		<< ", " << focus_changes << " focus changes";
+	LOG(INFO) << "focus: click to replay " << clicks_replayed
+		<< ", " << (clicks_replayed ? click_to_replay_ns / clicks_replayed : 0) << " ns mean"
+		<< ", " << click_to_replay_max_ns / 1000 << " us max";
+	for (int i = 0; i < kLatencyBuckets; i++) {
+		LOG(INFO) << "focus: click to replay " << kBucketNames[i] << " " << click_to_replay_buckets[i];
+	}
+	LOG(INFO) << "drag: " << drags << " drags"
+		<< ", " << drag_core_motion << " core motion"
+		<< ", " << drag_raw_motion << " raw motion"
+		<< ", " << drag_updates << " updates"
+		<< ", " << (drag_updates ? drag_to_flush_ns / drag_updates : 0) << " ns mean to flush"
+		<< ", " << drag_to_flush_max_ns / 1000 << " us max";
+	for (int i = 0; i < kLatencyBuckets; i++) {
+		LOG(INFO) << "drag: motion to flush " << kBucketNames[i] << " " << drag_to_flush_buckets[i];
+	}
+	LOG(INFO) << "keys: " << key_presses << " presses"
+		<< ", " << key_repeats << " repeats"
+		<< ", " << key_presses_coalesced << " coalesced";
+	LOG(INFO) << "focus: passive " << focus_by_model[1]
+		<< ", locally active " << focus_by_model[2]
+		<< ", globally active " << focus_by_model[3]
+		<< ", refused " << focus_refused;
+	for (int type = 0; type < LASTEvent; type++) {
+		if (event_allocations[type] > 0) {
+			LOG(INFO) << "allocations: " << EventTypeName(type) << " " << event_allocations[type];
+		}
+	}
+	LOG(INFO) << "allocations: " << allocating_events << " events allocated"
+		<< ", " << batches_allocating << " of " << batches << " batches"
+		<< ", " << batch_allocations << " allocations in batches";
+	const AllocationTotals totals = GetAllocationTotals();
+	LOG(INFO) << "allocations: " << totals.allocations << " total"
+		<< ", " << totals.allocations - totals.frees << " live"
+		<< ", " << totals.bytes / 1024 << " KiB allocated";
+
+	// fragmentation is the share of the heap malloc holds free but can't
+	// return
+	const struct mallinfo2 heap = mallinfo2();
+	LOG(INFO) << "heap: " << heap.uordblks / 1024 << " KiB in use"
+		<< ", " << heap.fordblks / 1024 << " KiB free"
+		<< ", " << heap.hblkhd / 1024 << " KiB mapped"
+		<< ", " << (heap.arena ? heap.fordblks * 100 / heap.arena : 0) << "% fragmented";
+	const PoolStats& pools = GetPoolStats();
+	LOG(INFO) << "heap: pools " << pools.slabs << " slabs"
+		<< ", " << pools.slab_bytes / 1024 << " KiB"
+		<< ", " << pools.nodes_in_use << " nodes in use"
+		<< ", " << pools.nodes_free << " free";
+	const ArenaStats arenas = GetArenaStats();
+	LOG(INFO) << "heap: client arenas " << arenas.blocks << " overflow blocks"
+		<< ", " << arenas.block_bytes / 1024 << " KiB"
+		<< ", " << arenas.bytes_copied / 1024 << " KiB copied";
+}
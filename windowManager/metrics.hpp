@@ -0,0 +1,140 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+extern "C" {
+#include <X11/X.h>
+}
+#include <cstdint>
+#include "ewmh.hpp"
+
+// how urgently an event is dispatched
+enum EventClass {
+	// input, new windows and focus changes
+	kEventCritical,
+	kEventBulk,
+	kEventClassCount,
+};
+
+// a coarse latency histogram: below 10 us, 100 us, 1 ms, 10 ms, and above
+const int kLatencyBuckets = 5;
+inline int LatencyBucket(uint64_t ns) {
+	int bucket = 0;
+	for (uint64_t limit = 10000; bucket < kLatencyBuckets - 1 && ns >= limit; limit *= 10) {
+		bucket++;
+	}
+	return bucket;
+}
+
+// counters kept by the window manager. dumped to the log on SIGUSR1
+struct Metrics {
+	// events dispatched per type, and those no handler did anything with
+	uint64_t events[LASTEvent] = {};
+	uint64_t events_unhandled = 0;
+	// events per class, and how long they waited between being read and
+	// being dispatched
+	uint64_t events_by_class[kEventClassCount] = {};
+	uint64_t queue_wait_ns[kEventClassCount] = {};
+	uint64_t queue_wait_max_ns[kEventClassCount] = {};
+	// critical events dispatched ahead of bulk events read before them
+	uint64_t events_prioritized = 0;
+
+	// how late poll() returned after its timeout, a measure of scheduling
+	// latency. see --latency_probe_ms
+	uint64_t timer_wakeups = 0;
+	uint64_t timer_lateness_ns = 0;
+	uint64_t timer_lateness_max_ns = 0;
+	uint64_t timer_lateness_buckets[kLatencyBuckets] = {};
+	// from poll() returning to the first event being dispatched
+	uint64_t wake_dispatches = 0;
+	uint64_t wake_to_dispatch_ns = 0;
+	uint64_t wake_to_dispatch_max_ns = 0;
+	uint64_t wake_to_dispatch_buckets[kLatencyBuckets] = {};
+
+	// startup adoption: windows framed, slices, total time and the longest
+	// slice, during which the server was grabbed
+	uint64_t adopt_windows = 0;
+	uint64_t adopt_slices = 0;
+	uint64_t adopt_ns = 0;
+	uint64_t adopt_max_pause_ns = 0;
+
+	// frames created, whether up front or lazily
+	uint64_t frames_created = 0;
+	// windows mapped unframed while their framing was deferred
+	uint64_t frames_deferred = 0;
+	// deferred windows that went away before they were framed
+	uint64_t frames_avoided = 0;
+	// deferred windows framed once they outlived the grace period
+	uint64_t frames_promoted_timeout = 0;
+	// deferred windows framed because the user interacted with them
+	uint64_t frames_promoted_interaction = 0;
+	// windows mapped without a frame by policy
+	uint64_t windows_unframed = 0;
+
+	// windows matched against the rule set, and the time spent doing it
+	uint64_t rule_matches = 0;
+	uint64_t rule_match_ns = 0;
+	// windows at least one rule applied to
+	uint64_t rule_matched_windows = 0;
+
+	// client messages handled, per type, and those nobody handles
+	uint64_t client_messages[kClientMessageCount] = {};
+	uint64_t client_messages_ignored = 0;
+
+	// session database lookups at Frame() and updates at Unframe(), and
+	// those skipped because another window without a role had the same key
+	uint64_t session_hits = 0;
+	uint64_t session_misses = 0;
+	uint64_t session_writes = 0;
+	uint64_t session_ambiguous = 0;
+
+	// events from clients over their event budget, and ConfigureRequests
+	// merged because of it
+	uint64_t events_over_budget = 0;
+	uint64_t configures_coalesced = 0;
+
+	// EnterNotify on frames with --focus_follows_mouse, those caused by
+	// grabs or coming back from the client, and the focus changes made.
+	// crossings in the same batch make one change at most
+	uint64_t focus_crossings = 0;
+	uint64_t focus_crossings_filtered = 0;
+	uint64_t focus_changes = 0;
+	// presses replayed with --click_to_focus, and the time from reading
+	// the press to flushing its replay, focus and raise
+	uint64_t clicks_replayed = 0;
+	uint64_t click_to_replay_ns = 0;
+	uint64_t click_to_replay_max_ns = 0;
+	uint64_t click_to_replay_buckets[kLatencyBuckets] = {};
+	// drags started, the motion events that moved them by source, and the
+	// geometry updates flushed, at most one per batch, with the time from
+	// reading the first motion of the batch to the flush
+	uint64_t drags = 0;
+	uint64_t drag_core_motion = 0;
+	uint64_t drag_raw_motion = 0;
+	uint64_t drag_updates = 0;
+	uint64_t drag_to_flush_ns = 0;
+	uint64_t drag_to_flush_max_ns = 0;
+	uint64_t drag_to_flush_buckets[kLatencyBuckets] = {};
+	// arrow key presses for keyboard moves and resizes, those that were
+	// autorepeats, and those merged into a geometry already pending for
+	// the batch commit
+	uint64_t key_presses = 0;
+	uint64_t key_repeats = 0;
+	uint64_t key_presses_coalesced = 0;
+	// focus requests per ICCCM input model, indexed by FocusModel, and
+	// those refused because the client takes no input
+	uint64_t focus_by_model[4] = {};
+	uint64_t focus_refused = 0;
+
+	// heap allocations made by the event thread while handling events, per
+	// event type, and events that allocated at all. batches count dispatch
+	// and commit. see --alloc_check
+	uint64_t event_allocations[LASTEvent] = {};
+	uint64_t allocating_events = 0;
+	uint64_t batches = 0;
+	uint64_t batches_allocating = 0;
+	uint64_t batch_allocations = 0;
+
+	void Log() const;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef PULKRAS_PLUGIN_API_H
+#define PULKRAS_PLUGIN_API_H
+
+// the C ABI between the window manager and plugins loaded with --plugins.
+//
+// a plugin is a shared object exporting
+//
+//   int pulkras_plugin_init(const struct pulkras_host* host,
+//                           struct pulkras_plugin* plugin);
+//
+// which fills in plugin and returns 0 on success. structs only ever grow at
+// the end, and abi_version is bumped when a change isn't backward compatible
+
+#include <X11/Xlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PULKRAS_PLUGIN_ABI_VERSION 1
+#define PULKRAS_PLUGIN_INIT_SYMBOL "pulkras_plugin_init"
+
+// a managed window, as seen by plugins. this is the window manager's own
+// client record, handed out by pointer and never copied. treat it as const
+struct pulkras_client {
+	Window window;
+	// None while the window is unframed
+	Window frame;
+	// frame position and client size
+	int x, y;
+	unsigned int width, height;
+	int workspace;
+	// _NET_WM_STATE properties set on the window, a mask of PULKRAS_STATE_*
+	uint32_t net_state;
+	// WM_CLASS, WM_WINDOW_ROLE and title. never null once framed
+	const char* wm_class;
+	const char* wm_instance;
+	const char* wm_role;
+	const char* wm_title;
+};
+
+// bits of pulkras_client.net_state, one per _NET_WM_STATE property. only
+// FULLSCREEN and ABOVE are acted on, the others are kept as the client set
+// them
+#define PULKRAS_STATE_FULLSCREEN (1u << 0)
+#define PULKRAS_STATE_MAXIMIZED_VERT (1u << 1)
+#define PULKRAS_STATE_MAXIMIZED_HORZ (1u << 2)
+#define PULKRAS_STATE_ABOVE (1u << 3)
+#define PULKRAS_STATE_BELOW (1u << 4)
+#define PULKRAS_STATE_HIDDEN (1u << 5)
+#define PULKRAS_STATE_STICKY (1u << 6)
+#define PULKRAS_STATE_DEMANDS_ATTENTION (1u << 7)
+#define PULKRAS_STATE_SKIP_TASKBAR (1u << 8)
+#define PULKRAS_STATE_SKIP_PAGER (1u << 9)
+#define PULKRAS_STATE_MODAL (1u << 10)
+#define PULKRAS_STATE_SHADED (1u << 11)
+
+// what a plugin's event hook returns
+enum pulkras_decision {
+	// let other plugins and the window manager handle the event
+	PULKRAS_CONTINUE = 0,
+	// the event is handled, stop dispatching it
+	PULKRAS_CONSUME = 1,
+};
+
+// services the window manager offers plugins. raise, move_resize and
+// activate are queued and applied with the window manager's own changes at
+// the end of the batch. windows that aren't managed are ignored
+struct pulkras_host {
+	uint32_t abi_version;
+	Display* display;
+	// passed back as the first argument of every function below
+	void* context;
+	void (*raise)(void* context, Window window);
+	void (*move_resize)(void* context, Window window, int x, int y,
+			unsigned int width, unsigned int height);
+	void (*activate)(void* context, Window window, Time time);
+	void (*set_workspace)(void* context, Window window, int workspace);
+	void (*close)(void* context, Window window);
+};
+
+struct pulkras_plugin {
+	// set to PULKRAS_PLUGIN_ABI_VERSION
+	uint32_t abi_version;
+	const char* name;
+	// bit n set to receive events of X type n
+	uint64_t event_mask;
+	// passed back to the hooks below
+	void* state;
+	// called for each subscribed event. client is null for events that
+	// aren't about a managed window. both pointers are only valid during
+	// the call. notifications the window manager's bookkeeping depends on,
+	// like DestroyNotify, reach it even when consumed
+	int (*on_event)(void* state, const XEvent* event, const struct pulkras_client* client);
+	// called before the plugin is unloaded. may be null
+	void (*destroy)(void* state);
+};
+
+typedef int (*pulkras_plugin_init_fn)(const struct pulkras_host* host, struct pulkras_plugin* plugin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
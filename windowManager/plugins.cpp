@@ -0,0 +1,186 @@
+#include "plugins.hpp"
+#include <glog/logging.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include "util.hpp"
+
+namespace {
+
+// budgets are enforced over windows of this length
+const uint64_t kBudgetWindowNs = 1000000000;
+
+// whether path is of type, a S_IF* file type, owned by us or root and
+// writable by no one else
+bool IsPrivate(const ::std::string& path, mode_t type) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		PLOG(ERROR) << "Failed to stat " << path;
+		return false;
+	}
+	if ((st.st_mode & S_IFMT) != type) {
+		LOG(ERROR) << path << " is not a " << (type == S_IFDIR ? "directory" : "regular file");
+		return false;
+	}
+	if (st.st_uid != getuid() && st.st_uid != 0) {
+		LOG(ERROR) << path << " is owned by uid " << st.st_uid << ", not by us or root";
+		return false;
+	}
+	if (st.st_mode & (S_IWGRP | S_IWOTH)) {
+		LOG(ERROR) << path << " is writable by group or others";
+		return false;
+	}
+	return true;
+}
+
+// resolves path to resolved, if it and its directory are private. a plugin
+// runs as us, so whoever can replace it can run code as us
+bool ResolvePlugin(const ::std::string& path, ::std::string* resolved) {
+	char* real = realpath(path.c_str(), nullptr);
+	if (real == nullptr) {
+		PLOG(ERROR) << "Failed to resolve plugin " << path;
+		return false;
+	}
+	*resolved = real;
+	free(real);
+	const size_t slash = resolved->rfind('/');
+	const ::std::string dir = resolved->substr(0, slash > 0 ? slash : 1);
+	return IsPrivate(dir, S_IFDIR) && IsPrivate(*resolved, S_IFREG);
+}
+
+}  // namespace
+
+PluginHost::~PluginHost() {
+	Unload();
+}
+
+void PluginHost::Load(const ::std::string& paths, const pulkras_host& host, uint64_t budget_us) {
+	budget_ns_ = budget_us * 1000;
+
+	::std::istringstream in(paths);
+	::std::string path, resolved;
+	while (::std::getline(in, path, ',')) {
+		if (path.empty()) {
+			continue;
+		}
+		if (!ResolvePlugin(path, &resolved)) {
+			LOG(ERROR) << "Refusing to load plugin " << path;
+			continue;
+		}
+		// the resolved path, so a symlink swapped after the checks can't
+		// redirect the load
+		void* handle = dlopen(resolved.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (handle == nullptr) {
+			LOG(ERROR) << "Failed to load plugin " << path << ": " << dlerror();
+			continue;
+		}
+		pulkras_plugin_init_fn init = reinterpret_cast<pulkras_plugin_init_fn>(
+				dlsym(handle, PULKRAS_PLUGIN_INIT_SYMBOL));
+		Plugin plugin;
+		plugin.handle = handle;
+		if (init == nullptr || init(&host, &plugin.plugin) != 0 ||
+				plugin.plugin.abi_version != PULKRAS_PLUGIN_ABI_VERSION ||
+				plugin.plugin.on_event == nullptr) {
+			LOG(ERROR) << "Failed to initialize plugin " << path;
+			dlclose(handle);
+			continue;
+		}
+		if (plugin.plugin.name == nullptr) {
+			plugin.plugin.name = "unnamed";
+		}
+
+		const uint32_t index = plugins_.size();
+		for (int type = 0; type < LASTEvent && type < 64; type++) {
+			if (plugin.plugin.event_mask & (uint64_t(1) << type)) {
+				subscribers_[type].push_back(index);
+			}
+		}
+		plugins_.push_back(plugin);
+		LOG(INFO) << "loaded plugin " << plugin.plugin.name << " from " << path;
+	}
+}
+
+void PluginHost::Unload() {
+	for (Plugin& plugin : plugins_) {
+		if (plugin.plugin.destroy != nullptr) {
+			plugin.plugin.destroy(plugin.plugin.state);
+		}
+		dlclose(plugin.handle);
+	}
+	plugins_.clear();
+	for (::std::vector<uint32_t>& subscribers : subscribers_) {
+		subscribers.clear();
+	}
+}
+
+bool PluginHost::Dispatch(const XEvent& e, const pulkras_client* client) {
+	if (e.type < 0 || e.type >= LASTEvent) {
+		return false;
+	}
+	const ::std::vector<uint32_t>& subscribers = subscribers_[e.type];
+	for (size_t i = 0; i < subscribers.size(); i++) {
+		Plugin& plugin = plugins_[subscribers[i]];
+
+		const uint64_t start_ns = MonotonicNs();
+		const int decision = plugin.plugin.on_event(plugin.plugin.state, &e, client);
+		const uint64_t end_ns = MonotonicNs();
+		const uint64_t elapsed_ns = end_ns - start_ns;
+
+		plugin.calls++;
+		plugin.total_ns += elapsed_ns;
+		plugin.max_ns = ::std::max(plugin.max_ns, elapsed_ns);
+		if (end_ns - plugin.window_start_ns >= kBudgetWindowNs) {
+			plugin.window_start_ns = end_ns;
+			plugin.window_ns = 0;
+		}
+		plugin.window_ns += elapsed_ns;
+		if (budget_ns_ > 0 && plugin.window_ns > budget_ns_) {
+			// Disable() edits the list we are iterating
+			Disable(&plugin);
+			i--;
+		}
+
+		if (decision == PULKRAS_CONSUME) {
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t PluginHost::event_types() const {
+	uint64_t event_types = 0;
+	for (int type = 0; type < LASTEvent && type < 64; type++) {
+		if (!subscribers_[type].empty()) {
+			event_types |= uint64_t(1) << type;
+		}
+	}
+	return event_types;
+}
+
+void PluginHost::Disable(Plugin* plugin) {
+	plugin->enabled = false;
+	subscriptions_changed_ = true;
+	const uint32_t index = plugin - plugins_.data();
+	for (::std::vector<uint32_t>& subscribers : subscribers_) {
+		subscribers.erase(
+				::std::remove(subscribers.begin(), subscribers.end(), index),
+				subscribers.end());
+	}
+	LOG(ERROR) << "disabled plugin " << plugin->plugin.name << ": spent "
+		<< plugin->window_ns / 1000 << " us in the last second, over its budget of "
+		<< budget_ns_ / 1000 << " us";
+}
+
+void PluginHost::LogStats() const {
+	for (const Plugin& plugin : plugins_) {
+		LOG(INFO) << "plugin " << plugin.plugin.name
+			<< (plugin.enabled ? "" : " (disabled)")
+			<< ": " << plugin.calls << " calls"
+			<< ", " << plugin.total_ns / 1000 << " us total"
+			<< ", " << (plugin.calls ? plugin.total_ns / plugin.calls : 0) << " ns mean"
+			<< ", " << plugin.max_ns << " ns max";
+	}
+}
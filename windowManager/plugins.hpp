@@ -0,0 +1,73 @@
+#ifndef PLUGINS_HPP
+#define PLUGINS_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "plugin_api.h"
+
+// loads plugins and dispatches events to them.
+//
+// every hook call is timed. a plugin that spends more than its budget in a
+// one second window is disabled, so a slow plugin shows up in the metrics
+// instead of stalling the desktop
+class PluginHost {
+	public:
+		PluginHost() = default;
+		~PluginHost();
+		PluginHost(const PluginHost&) = delete;
+		PluginHost& operator=(const PluginHost&) = delete;
+
+		// loads the comma separated .so paths in paths. skips a plugin unless
+		// it and its directory are owned by us or root and writable by no
+		// one else
+		void Load(const ::std::string& paths, const pulkras_host& host, uint64_t budget_us);
+		// calls the destroy hooks and unloads every plugin
+		void Unload();
+
+		bool empty() const { return plugins_.empty(); }
+
+		// bit n set for each X event type n an enabled plugin subscribes to
+		uint64_t event_types() const;
+		// whether event_types() changed since the last call, because a
+		// plugin was disabled
+		bool TakeSubscriptionsChanged() {
+			const bool changed = subscriptions_changed_;
+			subscriptions_changed_ = false;
+			return changed;
+		}
+
+		// runs the hooks subscribed to e's type. returns true if one of them
+		// consumed the event
+		bool Dispatch(const XEvent& e, const pulkras_client* client);
+
+		// logs call counts and time spent per plugin
+		void LogStats() const;
+
+	private:
+		struct Plugin {
+			void* handle = nullptr;
+			pulkras_plugin plugin = {};
+			bool enabled = true;
+			// accounting
+			uint64_t calls = 0;
+			uint64_t total_ns = 0;
+			uint64_t max_ns = 0;
+			// time spent in the current budget window
+			uint64_t window_start_ns = 0;
+			uint64_t window_ns = 0;
+		};
+
+		void Disable(Plugin* plugin);
+
+		::std::vector<Plugin> plugins_;
+		// per event type, the enabled plugins subscribed to it
+		::std::vector<uint32_t> subscribers_[LASTEvent];
+		uint64_t budget_ns_ = 0;
+		bool subscriptions_changed_ = false;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef POOL_ALLOCATOR_HPP
+#define POOL_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
+
+// slabs and nodes of all pools, for the heap metrics
+struct PoolStats {
+	uint64_t slabs = 0;
+	uint64_t slab_bytes = 0;
+	uint64_t nodes_in_use = 0;
+	uint64_t nodes_free = 0;
+};
+
+inline PoolStats& GetPoolStats() {
+	static PoolStats stats;
+	return stats;
+}
+
+// a slab allocator for node based containers. nodes are carved out of slabs
+// of kSlabNodes, and freed nodes go on a free list to be handed out again,
+// so a container that shrinks and grows back, like a set cleared every
+// batch, stops allocating once warm. slabs are never returned: a week of
+// window lifecycles reuses the same few slabs instead of scattering
+// records over the heap. arrays, like hash buckets, come from the heap as
+// usual.
+//
+// the free lists are shared by all containers with the same node type and
+// aren't locked: use it for containers of the event thread only
+template <typename T>
+class PoolAllocator {
+	public:
+		using value_type = T;
+
+		PoolAllocator() = default;
+		template <typename U>
+		PoolAllocator(const PoolAllocator<U>&) {}
+
+		T* allocate(size_t n) {
+			if (n != 1) {
+				return static_cast<T*>(::operator new(n * sizeof(T)));
+			}
+			if (free_list_ == nullptr) {
+				AddSlab();
+			}
+			Node* node = free_list_;
+			free_list_ = node->next;
+			GetPoolStats().nodes_free--;
+			GetPoolStats().nodes_in_use++;
+			return reinterpret_cast<T*>(node);
+		}
+
+		void deallocate(T* p, size_t n) {
+			if (n != 1) {
+				::operator delete(p);
+				return;
+			}
+			Node* node = reinterpret_cast<Node*>(p);
+			node->next = free_list_;
+			free_list_ = node;
+			GetPoolStats().nodes_in_use--;
+			GetPoolStats().nodes_free++;
+		}
+
+	private:
+		union Node {
+			Node* next;
+			alignas(T) char storage[sizeof(T)];
+		};
+
+		static const size_t kSlabNodes = 64;
+
+		static void AddSlab() {
+			Node* slab = static_cast<Node*>(::operator new(kSlabNodes * sizeof(Node)));
+			for (size_t i = 0; i < kSlabNodes; i++) {
+				slab[i].next = free_list_;
+				free_list_ = &slab[i];
+			}
+			PoolStats& stats = GetPoolStats();
+			stats.slabs++;
+			stats.slab_bytes += kSlabNodes * sizeof(Node);
+			stats.nodes_free += kSlabNodes;
+		}
+
+		static inline Node* free_list_ = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+	return false;
+}
+
+// hash containers on pooled nodes
+template <typename K, typename V>
+using PooledMap = ::std::unordered_map<K, V, ::std::hash<K>, ::std::equal_to<K>,
+	PoolAllocator<::std::pair<const K, V>>>;
+template <typename K>
+using PooledSet = ::std::unordered_set<K, ::std::hash<K>, ::std::equal_to<K>, PoolAllocator<K>>;
+
+#endif
@@ -0,0 +1,108 @@
+#include "realtime.hpp"
+#include <glog/logging.h>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+// stack and heap touched up front, so the event thread doesn't fault them
+// in later
+const size_t kPrefaultStackBytes = 256 * 1024;
+const size_t kPrefaultHeapBytes = 8 * 1024 * 1024;
+
+// parses "2,4-5" into set. returns false on a malformed list
+bool ParseCpus(const ::std::string& cpus, cpu_set_t* set) {
+	CPU_ZERO(set);
+	::std::istringstream in(cpus);
+	::std::string item;
+	while (::std::getline(in, item, ',')) {
+		char* end;
+		const long first = strtol(item.c_str(), &end, 10);
+		long last = first;
+		if (*end == '-') {
+			last = strtol(end + 1, &end, 10);
+		}
+		if (end == item.c_str() || *end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) {
+			return false;
+		}
+		for (long cpu = first; cpu <= last; cpu++) {
+			CPU_SET(cpu, set);
+		}
+	}
+	return CPU_COUNT(set) > 0;
+}
+
+// noinline, so the array really lives on the stack below the caller
+__attribute__((noinline)) void PrefaultStack() {
+	volatile char stack[kPrefaultStackBytes];
+	for (size_t i = 0; i < sizeof(stack); i += 4096) {
+		stack[i] = 0;
+	}
+}
+
+void LockMemory() {
+	// keep freed heap memory, so later allocations reuse locked pages
+	// rather than mapping new ones
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		PLOG(WARNING) << "mlockall failed, memory stays pageable";
+		return;
+	}
+	PrefaultStack();
+	char* heap = static_cast<char*>(malloc(kPrefaultHeapBytes));
+	if (heap != nullptr) {
+		memset(heap, 0, kPrefaultHeapBytes);
+		free(heap);
+	}
+	LOG(INFO) << "locked and prefaulted memory";
+}
+
+}  // namespace
+
+bool EnterRealtimeMode(const RealtimeOptions& options) {
+	// a. memory
+	if (options.lock_memory) {
+		LockMemory();
+	}
+
+	// b. CPU affinity
+	if (!options.cpus.empty()) {
+		cpu_set_t set;
+		if (!ParseCpus(options.cpus, &set)) {
+			LOG(WARNING) << "Bad CPU list " << options.cpus << ", affinity unchanged";
+		} else if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+			PLOG(WARNING) << "Failed to pin the event thread to CPUs " << options.cpus;
+		} else {
+			LOG(INFO) << "pinned the event thread to CPUs " << options.cpus;
+		}
+	}
+
+	// c. scheduling: SCHED_FIFO if asked and permitted, a lower nice level
+	// otherwise
+	if (options.fifo_priority > 0) {
+		sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = options.fifo_priority;
+		if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) == 0) {
+			LOG(INFO) << "running the event thread at SCHED_FIFO priority " << options.fifo_priority;
+			return true;
+		}
+		PLOG(WARNING) << "SCHED_FIFO not permitted, falling back to nice " << options.nice;
+	}
+	// nice is per thread on Linux
+	const pid_t tid = syscall(SYS_gettid);
+	if (setpriority(PRIO_PROCESS, tid, options.nice) != 0) {
+		PLOG(WARNING) << "Failed to set nice " << options.nice << ", scheduling unchanged";
+		return false;
+	}
+	LOG(INFO) << "running the event thread at nice " << options.nice;
+	return false;
+}
@@ -0,0 +1,25 @@
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#include <string>
+
+// how the event thread should be scheduled with --realtime
+struct RealtimeOptions {
+	// SCHED_FIFO priority, 1 to 99. 0 skips SCHED_FIFO and only renices
+	int fifo_priority = 0;
+	// nice level used when SCHED_FIFO is skipped or not permitted
+	int nice = -10;
+	// comma separated CPUs and ranges, "2,4-5". empty leaves the affinity
+	::std::string cpus;
+	// mlockall() and prefault the stack and heap
+	bool lock_memory = true;
+};
+
+// puts the calling thread, the event thread, in realtime mode. each step
+// that isn't permitted, typically for lack of CAP_SYS_NICE or
+// CAP_IPC_LOCK, is logged and skipped. threads and processes created
+// afterwards inherit the affinity but not SCHED_FIFO, which resets on
+// fork. returns whether the thread runs SCHED_FIFO
+bool EnterRealtimeMode(const RealtimeOptions& options);
+
+#endif
@@ -0,0 +1,198 @@
+#include "session_db.hpp"
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+const uint32_t kMagic = 0x50534442;  // "PSDB"
+const uint32_t kVersion = 2;
+// number of buckets, a power of two
+const uint32_t kCapacity = 4096;
+// buckets probed before a record evicts the one at its home bucket
+const uint32_t kMaxProbes = 16;
+
+uint64_t Fnv1a(uint64_t hash, const char* s) {
+	for (; *s != '\0'; s++) {
+		hash ^= static_cast<unsigned char>(*s);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+}  // namespace
+
+struct SessionDb::Header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t reserved;
+};
+
+struct SessionDb::Slot {
+	// zero for an unused slot
+	uint64_t key;
+	// higher is newer
+	uint32_t sequence;
+	int32_t x, y;
+	uint32_t width, height;
+	int32_t workspace;
+	uint32_t state;
+	// written last. covers all fields above
+	uint32_t checksum;
+
+	uint32_t Checksum() const {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(this);
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < offsetof(Slot, checksum); i++) {
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+	bool Intact() const { return key != 0 && checksum == Checksum(); }
+};
+
+// one cache line per slot
+struct SessionDb::Bucket {
+	alignas(64) Slot slots[2];
+};
+
+SessionDb::~SessionDb() {
+	if (map_ != nullptr) {
+		munmap(map_, map_size_);
+	}
+}
+
+bool SessionDb::Open(const ::std::string& path) {
+	static_assert(sizeof(Bucket) == 128, "a slot should fill a cache line");
+	const size_t size = sizeof(Bucket) + kCapacity * sizeof(Bucket);
+	const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		PLOG(WARNING) << "Failed to open session database " << path;
+		return false;
+	}
+	struct stat st;
+	const bool fresh = fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != size;
+	if (fresh && ftruncate(fd, size) != 0) {
+		PLOG(WARNING) << "Failed to size session database " << path;
+		close(fd);
+		return false;
+	}
+	void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		PLOG(WARNING) << "Failed to map session database " << path;
+		return false;
+	}
+
+	// the header takes the first bucket's worth of space
+	Header* header = static_cast<Header*>(map);
+	if (fresh || header->magic != kMagic || header->version != kVersion ||
+			header->capacity != kCapacity) {
+		memset(map, 0, size);
+		header->magic = kMagic;
+		header->version = kVersion;
+		header->capacity = kCapacity;
+	}
+
+	map_ = map;
+	map_size_ = size;
+	buckets_ = reinterpret_cast<Bucket*>(static_cast<char*>(map) + sizeof(Bucket));
+	capacity_ = kCapacity;
+	return true;
+}
+
+uint64_t SessionDb::Key(const char* res_class, const char* instance, const char* role) {
+	uint64_t hash = Fnv1a(0xcbf29ce484222325ULL, res_class);
+	hash = Fnv1a(hash ^ 0xff, instance);
+	hash = Fnv1a(hash ^ 0xff, role);
+	// zero marks unused slots
+	return hash != 0 ? hash : 1;
+}
+
+const SessionDb::Slot* SessionDb::Newest(const Bucket& bucket, uint64_t key) {
+	const Slot* newest = nullptr;
+	for (const Slot& slot : bucket.slots) {
+		if (slot.key == key && slot.Intact() &&
+				(newest == nullptr || slot.sequence > newest->sequence)) {
+			newest = &slot;
+		}
+	}
+	return newest;
+}
+
+bool SessionDb::Lookup(uint64_t key, SessionRecord* record) const {
+	if (!is_open()) {
+		return false;
+	}
+	for (uint32_t probe = 0; probe < kMaxProbes; probe++) {
+		const Bucket& bucket = buckets_[(key + probe) & (capacity_ - 1)];
+		const Slot* slot = Newest(bucket, key);
+		if (slot != nullptr) {
+			record->x = slot->x;
+			record->y = slot->y;
+			record->width = slot->width;
+			record->height = slot->height;
+			record->workspace = slot->workspace;
+			record->state = slot->state;
+			return true;
+		}
+		if (bucket.slots[0].key == 0 && bucket.slots[1].key == 0) {
+			return false;
+		}
+	}
+	return false;
+}
+
+void SessionDb::Store(uint64_t key, const SessionRecord& record) {
+	if (!is_open()) {
+		return;
+	}
+
+	// a. find the bucket holding key, else the first free one, else evict
+	// the home bucket
+	Bucket* target = nullptr;
+	for (uint32_t probe = 0; probe < kMaxProbes && target == nullptr; probe++) {
+		Bucket& bucket = buckets_[(key + probe) & (capacity_ - 1)];
+		if (Newest(bucket, key) != nullptr ||
+				(bucket.slots[0].key == 0 && bucket.slots[1].key == 0)) {
+			target = &bucket;
+		}
+	}
+	const bool evict = target == nullptr;
+	if (evict) {
+		target = &buckets_[key & (capacity_ - 1)];
+	}
+
+	// b. write the new version over the older slot
+	const Slot* newest = evict ? nullptr : Newest(*target, key);
+	Slot& slot = newest == &target->slots[0] ? target->slots[1] : target->slots[0];
+	const uint32_t sequence = newest != nullptr ? newest->sequence + 1 : 1;
+
+	slot.checksum = 0;
+	::std::atomic_signal_fence(::std::memory_order_release);
+	slot.key = key;
+	slot.sequence = sequence;
+	slot.x = record.x;
+	slot.y = record.y;
+	slot.width = record.width;
+	slot.height = record.height;
+	slot.workspace = record.workspace;
+	slot.state = record.state;
+	// seal the slot only once every field is in place
+	::std::atomic_signal_fence(::std::memory_order_release);
+	slot.checksum = slot.Checksum();
+
+	// an evicted bucket must not keep the previous key's other version
+	if (evict) {
+		Slot& other = &slot == &target->slots[0] ? target->slots[1] : target->slots[0];
+		if (other.key != key) {
+			other.key = 0;
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef SESSION_DB_HPP
+#define SESSION_DB_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// what the session database remembers about a window
+struct SessionRecord {
+	int x = 0, y = 0;
+	unsigned int width = 0, height = 0;
+	int workspace = 0;
+	// _NET_WM_STATE bits
+	uint32_t state = 0;
+};
+
+// remembers geometry, workspace and state per WM_CLASS class and instance
+// and WM_WINDOW_ROLE
+// across restarts of applications and of the window manager.
+//
+// the database is an open addressing hash table in a memory-mapped file, so
+// opening it is a single mmap() with nothing to parse, and lookups and
+// updates are O(1) memory accesses. each bucket holds two versions of its
+// record: an update is written to the older slot and sealed with a checksum,
+// leaving the newer one intact. a crash mid-write tears at most the slot
+// being written, and the reader falls back to the other. nothing is ever
+// fsync()ed, the page cache writes the file back in its own time
+class SessionDb {
+	public:
+		SessionDb() = default;
+		~SessionDb();
+		SessionDb(const SessionDb&) = delete;
+		SessionDb& operator=(const SessionDb&) = delete;
+
+		// maps the database at path, creating or resetting it if needed
+		bool Open(const ::std::string& path);
+		bool is_open() const { return buckets_ != nullptr; }
+
+		// the key of a window, a hash of its class, instance and role
+		static uint64_t Key(const char* res_class, const char* instance, const char* role);
+
+		bool Lookup(uint64_t key, SessionRecord* record) const;
+		void Store(uint64_t key, const SessionRecord& record);
+
+	private:
+		struct Header;
+		struct Slot;
+		struct Bucket;
+
+		// the newest intact slot of bucket for key, or null
+		static const Slot* Newest(const Bucket& bucket, uint64_t key);
+
+		void* map_ = nullptr;
+		size_t map_size_ = 0;
+		Bucket* buckets_ = nullptr;
+		uint32_t capacity_ = 0;
+};
+
+#endif
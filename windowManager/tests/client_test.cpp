@@ -0,0 +1,109 @@
+// gtest goes first, Xlib defines macros like None and Bool that clash
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include "client.hpp"
+
+namespace {
+
+// a client in a group of its own, as LinkClient() leaves it
+void InitClient(Client* client, Window window) {
+	client->window = window;
+	client->group_next = client->group_prev = client;
+}
+
+// links client into the leader group of head, as LinkClient() does
+void JoinGroup(Client* head, Client* client) {
+	client->group_next = head;
+	client->group_prev = head->group_prev;
+	head->group_prev->group_next = client;
+	head->group_prev = client;
+}
+
+int CountGroup(Client* client) {
+	int count = 0;
+	ForEachInGroup(client, [&count](Client*) { count++; });
+	return count;
+}
+
+}  // namespace
+
+TEST(AttachTransientTest, LinksChildUnderParent) {
+	Client parent, child;
+	InitClient(&parent, 1);
+	InitClient(&child, 2);
+	parent.workspace = 3;
+	EXPECT_TRUE(AttachTransient(&parent, &child));
+	EXPECT_EQ(child.transient_parent, &parent);
+	EXPECT_EQ(parent.first_transient, &child);
+	EXPECT_EQ(child.workspace, 3);
+	EXPECT_EQ(CountGroup(&child), 2);
+}
+
+TEST(AttachTransientTest, RefusesSelf) {
+	Client client;
+	InitClient(&client, 1);
+	EXPECT_FALSE(AttachTransient(&client, &client));
+	EXPECT_EQ(client.transient_parent, nullptr);
+	EXPECT_EQ(client.first_transient, nullptr);
+}
+
+// A is WM_TRANSIENT_FOR B and B is WM_TRANSIENT_FOR A
+TEST(AttachTransientTest, RefusesMutualTransients) {
+	Client a, b;
+	InitClient(&a, 1);
+	InitClient(&b, 2);
+	EXPECT_TRUE(AttachTransient(&a, &b));
+	EXPECT_FALSE(AttachTransient(&b, &a));
+	EXPECT_EQ(a.transient_parent, nullptr);
+	EXPECT_EQ(b.transient_parent, &a);
+	EXPECT_EQ(b.first_transient, nullptr);
+	// walking up from either ends at a, and the group is visited once
+	EXPECT_EQ(CountGroup(&a), 2);
+	EXPECT_EQ(CountGroup(&b), 2);
+}
+
+TEST(AttachTransientTest, RefusesLongerCycle) {
+	Client a, b, c;
+	InitClient(&a, 1);
+	InitClient(&b, 2);
+	InitClient(&c, 3);
+	EXPECT_TRUE(AttachTransient(&a, &b));
+	EXPECT_TRUE(AttachTransient(&b, &c));
+	EXPECT_FALSE(AttachTransient(&c, &a));
+	EXPECT_EQ(a.transient_parent, nullptr);
+	EXPECT_EQ(CountGroup(&c), 3);
+}
+
+TEST(ForEachInGroupTest, VisitsMembersParentedAcrossGroups) {
+	// app is a group of two, main and tool. the dialog is parented to
+	// another application's window, but belongs to app's group
+	Client main_window, tool, dialog, other;
+	InitClient(&main_window, 1);
+	InitClient(&tool, 2);
+	InitClient(&dialog, 3);
+	InitClient(&other, 4);
+	JoinGroup(&main_window, &tool);
+	JoinGroup(&main_window, &dialog);
+	ASSERT_TRUE(AttachTransient(&other, &dialog));
+
+	::std::vector<Window> visited;
+	ForEachInGroup(&tool, [&visited](Client* member) { visited.push_back(member->window); });
+	::std::sort(visited.begin(), visited.end());
+	EXPECT_EQ(visited, (::std::vector<Window>{1, 2, 3}));
+	// from the dialog, the walk starts at its transient root
+	EXPECT_EQ(CountGroup(&dialog), 2);
+}
+
+TEST(ForEachInGroupTest, VisitsEachClientOnce) {
+	// a and x share a group, and x is a transient of y, a transient of a
+	// from another group. x is reached through a, and not again as a root
+	Client a, x, y;
+	InitClient(&a, 1);
+	InitClient(&x, 2);
+	InitClient(&y, 3);
+	JoinGroup(&a, &x);
+	ASSERT_TRUE(AttachTransient(&a, &y));
+	ASSERT_TRUE(AttachTransient(&y, &x));
+	EXPECT_EQ(CountGroup(&a), 3);
+}
@@ -0,0 +1,30 @@
+// gtest goes first, Xlib defines macros like None and Bool that clash
+#include <gtest/gtest.h>
+#include "crossing.hpp"
+
+TEST(PendingCrossingTest, LaterCrossingWins) {
+	PendingCrossing crossing;
+	crossing.Offer(1, 100, 10);
+	crossing.Offer(2, 101, 20);
+	EXPECT_EQ(crossing.window(), 2u);
+	EXPECT_EQ(crossing.time(), 101u);
+}
+
+// the pointer entered A, then B. the crossing into A was held behind a bulk
+// event for A, so it is handled after the one into B. focus stays on B
+TEST(PendingCrossingTest, HeldCrossingDoesNotOverrideLaterOne) {
+	PendingCrossing crossing;
+	crossing.Offer(2, 101, 20);
+	crossing.Offer(1, 100, 10);
+	EXPECT_EQ(crossing.window(), 2u);
+	EXPECT_EQ(crossing.time(), 101u);
+}
+
+TEST(PendingCrossingTest, ClearAcceptsAnyCrossing) {
+	PendingCrossing crossing;
+	crossing.Offer(2, 101, 20);
+	crossing.Clear();
+	EXPECT_EQ(crossing.window(), static_cast<Window>(None));
+	crossing.Offer(1, 100, 10);
+	EXPECT_EQ(crossing.window(), 1u);
+}
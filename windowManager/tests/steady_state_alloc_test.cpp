@@ -0,0 +1,137 @@
+// gtest goes first, Xlib defines macros like None and Bool that clash
+#include <gtest/gtest.h>
+#include <vector>
+#include "alloc_counter.hpp"
+#include "client.hpp"
+#include "crossing.hpp"
+#include "pool_allocator.hpp"
+
+namespace {
+
+const size_t kExpectedWindows = 64;
+
+// the containers the event handlers touch, warmed the way
+// WindowManager::ReserveHotStructures() warms them, and the traffic
+// MapRequest, ConfigureRequest, EnterNotify and UnmapNotify cause in them
+class SteadyStateTest : public ::testing::Test {
+	protected:
+		void SetUp() override {
+			clients_.reserve(kExpectedWindows);
+			frames_.reserve(kExpectedWindows);
+			dirty_windows_.reserve(kExpectedWindows);
+			held_windows_.reserve(kExpectedWindows * 4);
+			for (Window w = 1; w <= kExpectedWindows; w++) {
+				clients_[w];
+				frames_[w] = nullptr;
+			}
+			for (Window w = 1; w <= kExpectedWindows * 4; w++) {
+				held_windows_.insert(w);
+			}
+			clients_.clear();
+			frames_.clear();
+			held_windows_.clear();
+		}
+
+		// Frame(): the client record, its strings and its frame
+		void Map(Window w) {
+			Client& client = clients_[w];
+			client.window = w;
+			client.frame = w + kFrameOffset;
+			client.wm_class = client.arena.CopyString("Class", 5);
+			client.wm_title = client.arena.CopyString("a title", 7);
+			frames_[client.frame] = &client;
+		}
+
+		// a batch holding w for a ConfigureRequest, which queues the
+		// geometry for the commit
+		void Configure(Window w) {
+			held_windows_.insert(w);
+			auto it = clients_.find(w);
+			if (it != clients_.end() && it->second.dirty == 0) {
+				it->second.dirty |= kDirtyGeometry;
+				dirty_windows_.push_back(w);
+			}
+		}
+
+		// EnterNotify offers focus, the commit takes it
+		void Focus(Window w, uint64_t queued_ns) {
+			pending_focus_.Offer(w, queued_ns, queued_ns);
+		}
+
+		void Commit() {
+			for (Window w : dirty_windows_) {
+				auto it = clients_.find(w);
+				if (it != clients_.end()) {
+					it->second.dirty = 0;
+				}
+			}
+			dirty_windows_.clear();
+			held_windows_.clear();
+			pending_focus_.Clear();
+		}
+
+		// Unframe() and RemoveClient()
+		void Unmap(Window w) {
+			auto it = clients_.find(w);
+			if (it == clients_.end()) {
+				return;
+			}
+			frames_.erase(it->second.frame);
+			clients_.erase(it);
+		}
+
+		// a round of window lifecycles, each window configured and focused
+		// while mapped
+		void Cycle(uint64_t round) {
+			for (Window w = 1; w <= kExpectedWindows; w++) {
+				Map(w);
+			}
+			for (Window w = 1; w <= kExpectedWindows; w++) {
+				Configure(w);
+				Focus(w, round * kExpectedWindows + w);
+				Configure(w);
+			}
+			Commit();
+			for (Window w = 1; w <= kExpectedWindows; w += 2) {
+				Unmap(w);
+			}
+			for (Window w = 1; w <= kExpectedWindows; w += 2) {
+				Map(w);
+			}
+			Commit();
+			for (Window w = 1; w <= kExpectedWindows; w++) {
+				Unmap(w);
+			}
+		}
+
+		static const Window kFrameOffset = 1 << 20;
+
+		PooledMap<Window, Client> clients_;
+		PooledMap<Window, Client*> frames_;
+		PooledSet<Window> held_windows_;
+		::std::vector<Window> dirty_windows_;
+		PendingCrossing pending_focus_;
+};
+
+TEST_F(SteadyStateTest, HandlersDontAllocateOnceWarm) {
+	const AllocationTotals before = GetAllocationTotals();
+	for (uint64_t round = 0; round < 100; round++) {
+		Cycle(round);
+	}
+	const AllocationTotals after = GetAllocationTotals();
+	EXPECT_EQ(after.allocations, before.allocations);
+	EXPECT_EQ(after.frees, before.frees);
+	EXPECT_EQ(after.bytes, before.bytes);
+}
+
+TEST_F(SteadyStateTest, CountsAllocations) {
+	// the check above means nothing unless the counter sees the heap
+	const AllocationTotals before = GetAllocationTotals();
+	::std::vector<Window>* grown = new ::std::vector<Window>(1);
+	delete grown;
+	const AllocationTotals after = GetAllocationTotals();
+	EXPECT_EQ(after.allocations, before.allocations + 2);
+	EXPECT_EQ(after.frees, before.frees + 2);
+}
+
+}  // namespace
@@ -0,0 +1,108 @@
+// times WindowRules::Match() against a generated rule set. with no rule
+// count, times 1000 and 10000 rules and fails unless ten times the rules
+// cost well under ten times as much per match.
+//
+//   ./window_rules_bench [rules] [matches]
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "window_rules.hpp"
+
+namespace {
+
+// per-match time, in ns, of num_matches matches against num_rules rules.
+// negative if the rules fail to load
+double TimeMatch(int num_rules, int num_matches) {
+	// a mix of the key kinds a real rule file has: exact classes, instances
+	// and roles, and title globs with leading, trailing and inner stars
+	char path[] = "/tmp/window_rules_bench.XXXXXX";
+	const int fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return -1;
+	}
+	close(fd);
+	{
+		::std::ofstream out(path);
+		for (int i = 0; i < num_rules; i++) {
+			switch (i % 4) {
+				case 0:
+					out << "class=App" << i << " workspace=" << i % 9 << "\n";
+					break;
+				case 1:
+					out << "instance=app" << i << " role=dialog placement=center\n";
+					break;
+				case 2:
+					out << "title=*Document" << i << "* border=" << i % 5 << "\n";
+					break;
+				case 3:
+					out << "class=App" << i - 3 << " title=\"Editor " << i << "?*\" noframe\n";
+					break;
+			}
+		}
+	}
+	WindowRules rules;
+	const bool loaded = rules.Load(path);
+	unlink(path);
+	if (!loaded) {
+		fprintf(stderr, "failed to load generated rules\n");
+		return -1;
+	}
+
+	// subjects that hit a rule, one per key kind, and one that misses all
+	::std::vector<::std::string> strings;
+	for (int i = 0; i < 16; i++) {
+		const int rule = (i * 7919) % (num_rules > 0 ? num_rules : 1);
+		strings.push_back("App" + ::std::to_string(rule - rule % 4));
+		strings.push_back("app" + ::std::to_string(rule - rule % 4 + 1));
+		strings.push_back("Editor " + ::std::to_string(rule - rule % 4 + 3) + "x - Document" +
+				::std::to_string(rule - rule % 4 + 2) + " [modified]");
+	}
+	strings.push_back("Unmatched");
+	strings.push_back("an unmatched title of a typical length for a browser tab");
+	::std::vector<RuleSubject> subjects;
+	for (size_t i = 0; i + 2 < strings.size(); i += 3) {
+		subjects.push_back({strings[i].c_str(), strings[i + 1].c_str(), "dialog", strings[i + 2].c_str()});
+	}
+	subjects.push_back({strings[strings.size() - 2].c_str(), "", "", strings.back().c_str()});
+
+	unsigned int matched = 0;
+	const auto start = ::std::chrono::steady_clock::now();
+	for (int i = 0; i < num_matches; i++) {
+		matched += rules.Match(subjects[i % subjects.size()]).num_matched;
+	}
+	const auto elapsed = ::std::chrono::steady_clock::now() - start;
+	const double ns = ::std::chrono::duration<double, ::std::nano>(elapsed).count();
+	const double per_match = num_matches > 0 ? ns / num_matches : 0.0;
+	printf("%zu rules, %d matches, %u rule hits: %.0f ns per match\n",
+			rules.size(), num_matches, matched, per_match);
+	return per_match;
+}
+
+// how much more a match may cost with ten times the rules. matching is
+// meant to be independent of the rule count but for a bitset word per 64
+// rules, and this leaves room for cache effects and noise
+const double kMaxScaling = 4;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	const int num_matches = argc > 2 ? atoi(argv[2]) : 100000;
+	if (argc > 1) {
+		return TimeMatch(atoi(argv[1]), num_matches) < 0;
+	}
+	const double small = TimeMatch(1000, num_matches);
+	const double large = TimeMatch(10000, num_matches);
+	if (small <= 0 || large < 0) {
+		return 1;
+	}
+	if (large > small * kMaxScaling) {
+		fprintf(stderr, "10x the rules cost %.1fx per match, over %.1fx\n", large / small, kMaxScaling);
+		return 1;
+	}
+	return 0;
+}
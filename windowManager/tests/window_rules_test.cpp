@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include "window_rules.hpp"
+
+namespace {
+
+class WindowRulesTest : public ::testing::Test {
+	protected:
+		void TearDown() override {
+			if (!path_.empty()) {
+				unlink(path_.c_str());
+			}
+		}
+
+		// writes text to a temporary rule file and loads it
+		bool Load(const ::std::string& text) {
+			TearDown();
+			char path[] = "/tmp/window_rules_test.XXXXXX";
+			const int fd = mkstemp(path);
+			if (fd < 0) {
+				return false;
+			}
+			close(fd);
+			path_ = path;
+			::std::ofstream(path_) << text;
+			return rules_.Load(path_);
+		}
+
+		RuleResult MatchTitle(const char* title) {
+			return rules_.Match({"Class", "instance", "", title});
+		}
+
+		bool TitleMatches(const char* title) {
+			return MatchTitle(title).num_matched > 0;
+		}
+
+		WindowRules rules_;
+		::std::string path_;
+};
+
+TEST_F(WindowRulesTest, StarMatchesAnythingIncludingNothing) {
+	ASSERT_TRUE(Load("title=* noframe\n"));
+	EXPECT_TRUE(TitleMatches(""));
+	EXPECT_TRUE(TitleMatches("x"));
+	EXPECT_TRUE(TitleMatches("any title at all"));
+}
+
+TEST_F(WindowRulesTest, StarInsideGlob) {
+	ASSERT_TRUE(Load("title=a*b**c noframe\n"));
+	EXPECT_TRUE(TitleMatches("abc"));
+	EXPECT_TRUE(TitleMatches("a--b--c"));
+	EXPECT_TRUE(TitleMatches("abcbc"));
+	EXPECT_FALSE(TitleMatches("ab"));
+	EXPECT_FALSE(TitleMatches("acb"));
+}
+
+TEST_F(WindowRulesTest, QuestionMarkMatchesExactlyOneByte) {
+	ASSERT_TRUE(Load("title=a?c noframe\n"));
+	EXPECT_TRUE(TitleMatches("abc"));
+	EXPECT_TRUE(TitleMatches("a?c"));
+	EXPECT_FALSE(TitleMatches("ac"));
+	EXPECT_FALSE(TitleMatches("abbc"));
+}
+
+TEST_F(WindowRulesTest, GlobsAreAnchoredAtBothEnds) {
+	ASSERT_TRUE(Load("title=foo noframe\n"));
+	EXPECT_TRUE(TitleMatches("foo"));
+	EXPECT_FALSE(TitleMatches("foobar"));
+	EXPECT_FALSE(TitleMatches("xfoo"));
+	EXPECT_FALSE(TitleMatches("fo"));
+}
+
+TEST_F(WindowRulesTest, EmptyTitles) {
+	ASSERT_TRUE(Load(
+			"title=\"\" workspace=1\n"
+			"title=? workspace=2\n"
+			"class=Class border=0\n"));
+	const RuleResult empty = MatchTitle("");
+	EXPECT_EQ(empty.num_matched, 2u);
+	EXPECT_EQ(empty.workspace, 1);
+	EXPECT_EQ(empty.border_width, 0);
+
+	const RuleResult one = MatchTitle("x");
+	EXPECT_EQ(one.num_matched, 2u);
+	EXPECT_EQ(one.workspace, 2);
+}
+
+TEST_F(WindowRulesTest, QuotedValuesHoldSpacesAndHashes) {
+	ASSERT_TRUE(Load(
+			"title=\"Picture in picture\" placement=pointer  # a comment\n"
+			"title=\"#1 *\" workspace=3\n"));
+	EXPECT_EQ(MatchTitle("Picture in picture").placement, Placement::kPointer);
+	EXPECT_FALSE(TitleMatches("Picture"));
+	EXPECT_EQ(MatchTitle("#1 hit").workspace, 3);
+	EXPECT_EQ(rules_.size(), 2u);
+}
+
+TEST_F(WindowRulesTest, LaterRulesOverrideEarlierOnes) {
+	ASSERT_TRUE(Load(
+			"class=Class workspace=1 border=2\n"
+			"title=*x* workspace=4\n"));
+	const RuleResult result = MatchTitle("xx");
+	EXPECT_EQ(result.workspace, 4);
+	EXPECT_EQ(result.border_width, 2);
+}
+
+TEST_F(WindowRulesTest, RejectsBadNumbers) {
+	ASSERT_TRUE(Load(
+			"title=* workspace=2x\n"
+			"title=* workspace=-1\n"
+			"title=* workspace=\n"
+			"title=* border=99999999999\n"
+			"title=* border= 3\n"
+			"title=* workspace=7\n"));
+	ASSERT_EQ(rules_.size(), 1u);
+	EXPECT_EQ(MatchTitle("t").workspace, 7);
+}
+
+TEST_F(WindowRulesTest, RejectsUnterminatedQuote) {
+	ASSERT_TRUE(Load("title=\"open noframe\n"));
+	EXPECT_EQ(rules_.size(), 0u);
+}
+
+TEST_F(WindowRulesTest, LoadingAgainReplacesRules) {
+	ASSERT_TRUE(Load("class=Class workspace=1\ntitle=*x* border=2\n"));
+	ASSERT_TRUE(Load("class=Class workspace=5\n"));
+	EXPECT_EQ(rules_.size(), 1u);
+	const RuleResult result = MatchTitle("x");
+	EXPECT_EQ(result.num_matched, 1u);
+	EXPECT_EQ(result.workspace, 5);
+	EXPECT_EQ(result.border_width, -1);
+}
+
+TEST_F(WindowRulesTest, GlobsSharingALiteral) {
+	ASSERT_TRUE(Load(
+			"title=*Doc* workspace=1\n"
+			"title=Doc?* border=1\n"
+			"title=*Doc placement=center\n"));
+	const RuleResult both = MatchTitle("Doc1 - Doc");
+	EXPECT_EQ(both.num_matched, 3u);
+	EXPECT_EQ(MatchTitle("a Doc b").num_matched, 1u);
+	EXPECT_EQ(MatchTitle("Do c").num_matched, 0u);
+}
+
+TEST_F(WindowRulesTest, FailsOnMissingFile) {
+	EXPECT_FALSE(rules_.Load("/nonexistent/pulkras-rules"));
+}
+
+}  // namespace
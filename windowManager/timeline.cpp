@@ -0,0 +1,93 @@
+#include "timeline.hpp"
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include "util.hpp"
+
+namespace {
+
+const char* SpanName(SpanKind kind, int detail) {
+	switch (kind) {
+		case SpanKind::kEvent:
+			return EventTypeName(detail);
+		case SpanKind::kBatch:
+			return "batch";
+		case SpanKind::kCommit:
+			return "commit";
+		case SpanKind::kGrab:
+			return "server grab";
+		case SpanKind::kConfigReload:
+			return "config reload";
+	}
+	return "unknown";
+}
+
+const char* SpanCategory(SpanKind kind) {
+	return kind == SpanKind::kEvent ? "event" : "loop";
+}
+
+}  // namespace
+
+void Timeline::Start(size_t capacity) {
+	spans_.assign(capacity, Span());
+	next_ = 0;
+}
+
+bool Timeline::Dump(const ::std::string& path) const {
+	if (!enabled()) {
+		return false;
+	}
+	// replace the last dump with a file of our own. O_EXCL and O_NOFOLLOW
+	// refuse a file or link someone else planted there
+	if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+		PLOG(ERROR) << "Failed to remove the previous " << path;
+		return false;
+	}
+	const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		PLOG(ERROR) << "Failed to open " << path;
+		return false;
+	}
+	FILE* out = fdopen(fd, "w");
+	if (out == nullptr) {
+		PLOG(ERROR) << "Failed to open " << path;
+		close(fd);
+		return false;
+	}
+
+	// complete ("X") events with microsecond timestamps. the event loop is a
+	// single thread, so every span goes on one track
+	const int pid = getpid();
+	fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+			"\"args\":{\"name\":\"event loop\"}}", pid);
+	const uint64_t size = spans_.size();
+	const uint64_t first = next_ > size ? next_ - size : 0;
+	for (uint64_t i = first; i < next_; i++) {
+		const Span& span = spans_[i % size];
+		fprintf(out,
+				",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":1,"
+				"\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64 ".%03u,"
+				"\"args\":{\"window\":%lu,\"requests\":%lu,\"events\":%d}}",
+				SpanName(span.kind, span.detail),
+				SpanCategory(span.kind),
+				pid,
+				span.start_ns / 1000,
+				static_cast<unsigned int>(span.start_ns % 1000),
+				span.duration_ns / 1000,
+				static_cast<unsigned int>(span.duration_ns % 1000),
+				span.window,
+				span.requests,
+				span.kind == SpanKind::kBatch ? span.detail : 1);
+	}
+	fprintf(out, "\n]}\n");
+	if (fclose(out) != 0) {
+		PLOG(ERROR) << "Failed to write " << path;
+		return false;
+	}
+	LOG(INFO) << "wrote " << next_ - first << " spans to " << path;
+	return true;
+}
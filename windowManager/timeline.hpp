@@ -0,0 +1,71 @@
+#ifndef TIMELINE_HPP
+#define TIMELINE_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// what a timeline span covers
+enum class SpanKind : uint8_t {
+	// handling a single event, detail is its type
+	kEvent,
+	// a drained batch of events, from the first read to the flush. detail
+	// is the number of events
+	kBatch,
+	// CommitBatch() applying the batch's queued changes
+	kCommit,
+	// the server was grabbed
+	kGrab,
+	// a config snapshot was swapped in
+	kConfigReload,
+};
+
+// records what the event loop did, and how long each step took, into a
+// preallocated ring of spans, to be dumped as a Chrome trace on SIGUSR2.
+//
+// recording a span is a store into the ring, so the timeline can stay
+// enabled on a live session. only the newest spans are kept
+class Timeline {
+	public:
+		Timeline() = default;
+
+		// keeps the last capacity spans. 0 leaves the timeline disabled
+		void Start(size_t capacity);
+		bool enabled() const { return !spans_.empty(); }
+
+		// requests is how many X requests were issued during the span
+		void Record(SpanKind kind, int detail, Window window,
+				uint64_t start_ns, uint64_t end_ns, unsigned long requests) {
+			Span& span = spans_[next_ % spans_.size()];
+			span.start_ns = start_ns;
+			span.duration_ns = end_ns - start_ns;
+			span.window = window;
+			span.requests = requests;
+			span.kind = kind;
+			span.detail = detail;
+			next_++;
+		}
+
+		// writes the recorded spans to path in the Chrome trace event format,
+		// which chrome://tracing and ui.perfetto.dev load
+		bool Dump(const ::std::string& path) const;
+
+	private:
+		struct Span {
+			uint64_t start_ns;
+			uint64_t duration_ns;
+			Window window;
+			unsigned long requests;
+			SpanKind kind;
+			int detail;
+		};
+
+		::std::vector<Span> spans_;
+		// total spans recorded. the oldest kept one is next_ - size
+		uint64_t next_ = 0;
+};
+
+#endif
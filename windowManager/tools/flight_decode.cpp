@@ -0,0 +1,141 @@
+// prints the records of a flight recorder file, oldest first.
+//
+//   flight_decode ~/.cache/pulkras-flight.bin.prev
+//
+// with --last N, prints only the newest N records
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "../flight_recorder.hpp"
+
+namespace {
+
+const char* KindName(FlightKind kind) {
+	switch (kind) {
+		case FlightKind::kNone:
+			return "none";
+		case FlightKind::kStart:
+			return "start";
+		case FlightKind::kEvent:
+			return "event";
+		case FlightKind::kHandled:
+			return "handled";
+		case FlightKind::kFlush:
+			return "flush";
+		case FlightKind::kXError:
+			return "x-error";
+		case FlightKind::kFrame:
+			return "frame";
+		case FlightKind::kUnframe:
+			return "unframe";
+		case FlightKind::kAbort:
+			return "abort";
+	}
+	return "unknown";
+}
+
+void Print(const FlightHeader& header, const FlightRecord& record) {
+	// wall clock time of the record, to line it up with the glog output
+	const int64_t wall_ns = static_cast<int64_t>(record.time_ns) + header.realtime_offset_ns;
+	const time_t seconds = wall_ns / 1000000000;
+	tm local;
+	localtime_r(&seconds, &local);
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%H:%M:%S", &local);
+	printf("%s.%06ld %-8s", stamp, static_cast<long>(wall_ns % 1000000000 / 1000), KindName(record.kind));
+
+	switch (record.kind) {
+		case FlightKind::kStart:
+			printf(" pid %u", record.value);
+			break;
+		case FlightKind::kEvent:
+			printf(" %-16s window 0x%x serial %u", EventTypeName(record.detail), record.window, record.serial);
+			break;
+		case FlightKind::kHandled:
+			printf(" %-16s window 0x%x serial %u, %u requests",
+					EventTypeName(record.detail), record.window, record.serial, record.value);
+			break;
+		case FlightKind::kFlush:
+			printf(" requests %u..%u", record.value, record.aux);
+			break;
+		case FlightKind::kXError:
+			printf(" error %u in request %u on 0x%x, serial %u",
+					record.detail, record.value, record.window, record.serial);
+			break;
+		case FlightKind::kFrame:
+			printf(" window 0x%x frame 0x%x", record.window, record.value);
+			break;
+		case FlightKind::kUnframe:
+			printf(" window 0x%x", record.window);
+			break;
+		default:
+			break;
+	}
+	printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	const char* path = nullptr;
+	uint64_t last = UINT64_MAX;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--last") == 0 && i + 1 < argc) {
+			last = strtoull(argv[++i], nullptr, 10);
+		} else {
+			path = argv[i];
+		}
+	}
+	if (path == nullptr) {
+		fprintf(stderr, "usage: %s [--last N] FILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+	if (static_cast<size_t>(st.st_size) < sizeof(FlightHeader)) {
+		fprintf(stderr, "%s: too short\n", path);
+		return EXIT_FAILURE;
+	}
+	void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+
+	const FlightHeader& header = *static_cast<const FlightHeader*>(map);
+	if (header.magic != kFlightMagic || header.version != kFlightVersion ||
+			header.record_size != sizeof(FlightRecord) ||
+			header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0 ||
+			sizeof(FlightHeader) + static_cast<size_t>(header.capacity) * sizeof(FlightRecord) >
+				static_cast<size_t>(st.st_size)) {
+		fprintf(stderr, "%s: not a flight recorder file\n", path);
+		return EXIT_FAILURE;
+	}
+	const FlightRecord* records = reinterpret_cast<const FlightRecord*>(&header + 1);
+
+	// the ring holds the newest capacity records
+	const uint64_t next = header.next;
+	uint64_t first = next > header.capacity ? next - header.capacity : 0;
+	if (next - first > last) {
+		first = next - last;
+	}
+	printf("%" PRIu64 " records written, showing %" PRIu64 "\n", next, next - first);
+	for (uint64_t i = first; i < next; i++) {
+		Print(header, records[i & (header.capacity - 1)]);
+	}
+	munmap(map, st.st_size);
+	return EXIT_SUCCESS;
+}
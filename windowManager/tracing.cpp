@@ -0,0 +1,11 @@
+#include "tracing.hpp"
+
+#ifdef PULKRAS_HAVE_USDT
+// one semaphore per probe, raised by the kernel while a tracer uses it
+#define PULKRAS_DEFINE_SEMAPHORE(name) \
+	__attribute__((section(".probes"))) volatile unsigned short pulkras_##name##_semaphore = 0;
+extern "C" {
+PULKRAS_PROBES(PULKRAS_DEFINE_SEMAPHORE)
+}
+#undef PULKRAS_DEFINE_SEMAPHORE
+#endif
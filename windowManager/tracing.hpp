@@ -0,0 +1,73 @@
+#ifndef TRACING_HPP
+#define TRACING_HPP
+
+// USDT probes for perf and bpftrace, in the "pulkras" provider.
+//
+// a probe compiles to a nop plus a note in the ELF file, behind a test of
+// its semaphore, which the kernel raises while a tracer is attached. so
+// until then a probe costs a load and a branch, and its arguments aren't
+// evaluated. probes and their arguments:
+//
+//   event_receive(type, window, serial)    an event was read off the queue
+//   dispatch_start(type, window, serial)   before any handler runs
+//   dispatch_end(type, window, serial)     after the last handler returned
+//   frame_start(window)
+//   frame_end(window, frame)               frame is 0 if none was created
+//   unframe_start(window)
+//   unframe_end(window)
+//   flush_start(request)                   request is the next sequence
+//   flush_end(request)                     number, see NextRequest()
+//   x_error(error_code, request_code, resource, serial)
+//
+// see tools/bpftrace for example scripts. probes are compiled in when
+// <sys/sdt.h> is available, unless PULKRAS_NO_USDT is defined
+
+#if !defined(PULKRAS_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define PULKRAS_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef PULKRAS_HAVE_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+// every probe, to declare and define the semaphores
+#define PULKRAS_PROBES(X) \
+	X(event_receive) \
+	X(dispatch_start) \
+	X(dispatch_end) \
+	X(frame_start) \
+	X(frame_end) \
+	X(unframe_start) \
+	X(unframe_end) \
+	X(flush_start) \
+	X(flush_end) \
+	X(x_error)
+
+// defined in tracing.cpp, in the .probes section tracers look for
+#define PULKRAS_DECLARE_SEMAPHORE(name) extern "C" volatile unsigned short pulkras_##name##_semaphore;
+PULKRAS_PROBES(PULKRAS_DECLARE_SEMAPHORE)
+#undef PULKRAS_DECLARE_SEMAPHORE
+
+// whether a tracer is attached to probe name. for call sites that compute
+// something only the probe uses
+#define PULKRAS_TRACE_ENABLED(name) __builtin_expect(pulkras_##name##_semaphore != 0, 0)
+
+#define PULKRAS_TRACE1(name, a) \
+	do { if (PULKRAS_TRACE_ENABLED(name)) DTRACE_PROBE1(pulkras, name, a); } while (0)
+#define PULKRAS_TRACE2(name, a, b) \
+	do { if (PULKRAS_TRACE_ENABLED(name)) DTRACE_PROBE2(pulkras, name, a, b); } while (0)
+#define PULKRAS_TRACE3(name, a, b, c) \
+	do { if (PULKRAS_TRACE_ENABLED(name)) DTRACE_PROBE3(pulkras, name, a, b, c); } while (0)
+#define PULKRAS_TRACE4(name, a, b, c, d) \
+	do { if (PULKRAS_TRACE_ENABLED(name)) DTRACE_PROBE4(pulkras, name, a, b, c, d); } while (0)
+#else
+#define PULKRAS_TRACE_ENABLED(name) false
+#define PULKRAS_TRACE1(name, a) do {} while (0)
+#define PULKRAS_TRACE2(name, a, b) do {} while (0)
+#define PULKRAS_TRACE3(name, a, b, c) do {} while (0)
+#define PULKRAS_TRACE4(name, a, b, c, d) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef UTIL_HPP
+#define UTIL_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+
+// represents a 2D size
+template <typename T>
+struct Size {
+	T width, height;
+
+	Size() = default;
+	Size(T w, T h) : width(w), height(h) {}
+};
+
+template <typename T>
+::std::ostream& operator<<(::std::ostream& out, const Size<T>& size) {
+	return out << size.width << 'x' << size.height;
+}
+
+// monotonic clock in milliseconds, used for timers in the event loop
+inline uint64_t MonotonicMs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// name of a core X event type, for traces and logs
+inline const char* EventTypeName(int type) {
+	static const char* const kNames[] = {
+		"Error", "Reply", "KeyPress", "KeyRelease", "ButtonPress",
+		"ButtonRelease", "MotionNotify", "EnterNotify", "LeaveNotify", "FocusIn",
+		"FocusOut", "KeymapNotify", "Expose", "GraphicsExpose", "NoExpose",
+		"VisibilityNotify", "CreateNotify", "DestroyNotify", "UnmapNotify", "MapNotify",
+		"MapRequest", "ReparentNotify", "ConfigureNotify", "ConfigureRequest", "GravityNotify",
+		"ResizeRequest", "CirculateNotify", "CirculateRequest", "PropertyNotify", "SelectionClear",
+		"SelectionRequest", "SelectionNotify", "ColormapNotify", "ClientMessage", "MappingNotify",
+		"GenericEvent",
+	};
+	const int count = sizeof(kNames) / sizeof(kNames[0]);
+	return type >= 0 && type < count ? kNames[type] : "Unknown";
+}
+
+// monotonic clock in nanoseconds, used to time handlers
+inline uint64_t MonotonicNs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "watchdog.hpp"
+#include <glog/logging.h>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "util.hpp"
+
+namespace {
+
+// frames captured by OnStackSignal() on the event loop thread
+const int kMaxFrames = 64;
+void* stack_frames[kMaxFrames];
+int stack_depth = 0;
+::std::atomic<bool> stack_captured{false};
+
+// how long to wait for the event loop to answer the stack signal
+const uint64_t kStackTimeoutNs = 100000000;
+
+// turns a backtrace_symbols() line, "binary(mangled+0x1f) [0x...]", into
+// one with the demangled name
+::std::string Demangle(const char* symbol) {
+	const char* open = strchr(symbol, '(');
+	const char* plus = open != nullptr ? strchr(open, '+') : nullptr;
+	if (plus == nullptr || plus == open + 1) {
+		return symbol;
+	}
+	const ::std::string mangled(open + 1, plus);
+	int status;
+	char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+	if (status != 0) {
+		return symbol;
+	}
+	::std::string result = ::std::string(symbol, open + 1) + demangled + plus;
+	free(demangled);
+	return result;
+}
+
+}  // namespace
+
+Watchdog::~Watchdog() {
+	if (thread_.joinable()) {
+		{
+			::std::lock_guard<::std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+	}
+}
+
+void Watchdog::Start(Display* display, uint64_t threshold_ms) {
+	if (threshold_ms == 0) {
+		return;
+	}
+	display_ = display;
+	threshold_ns_ = threshold_ms * 1000000;
+	loop_thread_ = pthread_self();
+
+	// backtrace() loads libgcc on first use, which isn't safe in a signal
+	// handler, so warm it up here
+	void* frame;
+	backtrace(&frame, 1);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &Watchdog::OnStackSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	CHECK_EQ(sigaction(SIGRTMIN, &action, nullptr), 0);
+
+	heartbeat_ns_.store(MonotonicNs(), ::std::memory_order_relaxed);
+	thread_ = ::std::thread(&Watchdog::WatchThread, this);
+}
+
+void Watchdog::SetFifoPriority(int priority) {
+	if (!thread_.joinable()) {
+		return;
+	}
+	sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	// returns the error rather than setting errno
+	const int error = pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &param);
+	if (error != 0) {
+		LOG(WARNING) << "Failed to run the watchdog at SCHED_FIFO priority " << priority
+			<< ": " << strerror(error);
+		return;
+	}
+	LOG(INFO) << "running the watchdog at SCHED_FIFO priority " << priority;
+}
+
+void Watchdog::OnStackSignal(int signo) {
+	stack_depth = backtrace(stack_frames, kMaxFrames);
+	stack_captured.store(true, ::std::memory_order_release);
+}
+
+void Watchdog::WatchThread() {
+	// check a few times per threshold, so stalls are caught soon after they
+	// cross it
+	const ::std::chrono::nanoseconds period(::std::max<uint64_t>(threshold_ns_ / 4, 10000000));
+	::std::unique_lock<::std::mutex> lock(mutex_);
+	while (!wake_.wait_for(lock, period, [this] { return stopping_; })) {
+		if (idle_.load(::std::memory_order_acquire) || stalled_.load(::std::memory_order_relaxed)) {
+			continue;
+		}
+		const uint64_t heartbeat_ns = heartbeat_ns_.load(::std::memory_order_acquire);
+		const uint64_t now_ns = MonotonicNs();
+		if (now_ns > heartbeat_ns && now_ns - heartbeat_ns > threshold_ns_) {
+			stalled_.store(true, ::std::memory_order_relaxed);
+			ReportStall(now_ns - heartbeat_ns);
+		}
+	}
+}
+
+void Watchdog::ReportStall(uint64_t stalled_ns) {
+	// the request counters as of the last beat. the event's own requests
+	// start at next_request
+	const unsigned long next_request = next_request_.load(::std::memory_order_relaxed);
+	const unsigned long last_processed = last_processed_.load(::std::memory_order_relaxed);
+	LOG(ERROR) << "event loop stalled for " << stalled_ns / 1000000 << " ms"
+		<< " handling event " << event_type_.load(::std::memory_order_relaxed)
+		<< " on window " << window_.load(::std::memory_order_relaxed)
+		<< ", its requests from " << next_request
+		<< ", server done with " << last_processed << " when it started";
+
+	// have the event loop capture its own stack
+	stack_captured.store(false, ::std::memory_order_relaxed);
+	pthread_kill(loop_thread_, SIGRTMIN);
+	const uint64_t deadline_ns = MonotonicNs() + kStackTimeoutNs;
+	while (!stack_captured.load(::std::memory_order_acquire)) {
+		if (MonotonicNs() >= deadline_ns) {
+			LOG(ERROR) << "event loop did not answer the stack signal";
+			return;
+		}
+		::std::this_thread::sleep_for(::std::chrono::milliseconds(1));
+	}
+	char** symbols = backtrace_symbols(stack_frames, stack_depth);
+	if (symbols == nullptr) {
+		return;
+	}
+	// the first two frames are the signal handler and the signal trampoline
+	for (int i = 2; i < stack_depth; i++) {
+		LOG(ERROR) << "  #" << i - 2 << " " << Demangle(symbols[i]);
+	}
+	free(symbols);
+}
+
+void Watchdog::EndStall(uint64_t now_ns) {
+	const uint64_t stall_ns = now_ns - heartbeat_ns_.load(::std::memory_order_relaxed);
+	stalls_.fetch_add(1, ::std::memory_order_relaxed);
+	stall_total_ns_.fetch_add(stall_ns, ::std::memory_order_relaxed);
+	if (stall_ns > stall_max_ns_.load(::std::memory_order_relaxed)) {
+		stall_max_ns_.store(stall_ns, ::std::memory_order_relaxed);
+	}
+	stalled_.store(false, ::std::memory_order_relaxed);
+	LOG(WARNING) << "event loop recovered after " << stall_ns / 1000000 << " ms";
+}
+
+void Watchdog::LogStats() const {
+	const uint64_t stalls = stalls_.load(::std::memory_order_relaxed);
+	const uint64_t total_ns = stall_total_ns_.load(::std::memory_order_relaxed);
+	LOG(INFO) << "stalls: " << stalls
+		<< ", " << total_ns / 1000000 << " ms total"
+		<< ", " << (stalls ? total_ns / stalls / 1000000 : 0) << " ms mean"
+		<< ", " << stall_max_ns_.load(::std::memory_order_relaxed) / 1000000 << " ms max";
+}
@@ -0,0 +1,95 @@
+#ifndef WATCHDOG_HPP
+#define WATCHDOG_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <pthread.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// detects event loop stalls, like a round trip to a hung server.
+//
+// the event loop beats once per event and marks when it goes idle in poll.
+// a watchdog thread checks the heartbeat, and when the loop has been busy
+// on one event for longer than the threshold, interrupts it with a signal
+// to capture its stack, then logs the stack with the event and the X
+// requests in flight
+class Watchdog {
+	public:
+		Watchdog() = default;
+		~Watchdog();
+		Watchdog(const Watchdog&) = delete;
+		Watchdog& operator=(const Watchdog&) = delete;
+
+		// starts watching the calling thread, which must be the event loop.
+		// 0 leaves the watchdog disabled
+		void Start(Display* display, uint64_t threshold_ms);
+		// runs the watchdog thread at SCHED_FIFO priority, which must be
+		// above the event thread's for the watchdog to preempt a spinning
+		// loop. does nothing when the watchdog is disabled
+		void SetFifoPriority(int priority);
+
+		// called by the event loop before handling an event
+		void Beat(int event_type, Window window, uint64_t now_ns) {
+			if (stalled_.load(::std::memory_order_relaxed)) {
+				EndStall(now_ns);
+			}
+			event_type_.store(event_type, ::std::memory_order_relaxed);
+			window_.store(window, ::std::memory_order_relaxed);
+			// the display belongs to this thread, so the watchdog reads the
+			// request counters from here rather than from it
+			if (display_ != nullptr) {
+				next_request_.store(NextRequest(display_), ::std::memory_order_relaxed);
+				last_processed_.store(LastKnownRequestProcessed(display_), ::std::memory_order_relaxed);
+			}
+			heartbeat_ns_.store(now_ns, ::std::memory_order_release);
+		}
+		// called by the event loop before and after blocking in poll
+		void Idle(uint64_t now_ns) {
+			Beat(0, None, now_ns);
+			idle_.store(true, ::std::memory_order_release);
+		}
+		void Busy(uint64_t now_ns) {
+			Beat(0, None, now_ns);
+			idle_.store(false, ::std::memory_order_release);
+		}
+
+		// logs stall counts and durations
+		void LogStats() const;
+
+	private:
+		void WatchThread();
+		void ReportStall(uint64_t stalled_ns);
+		void EndStall(uint64_t now_ns);
+		static void OnStackSignal(int signo);
+
+		Display* display_ = nullptr;
+		uint64_t threshold_ns_ = 0;
+		pthread_t loop_thread_;
+		::std::thread thread_;
+		::std::mutex mutex_;
+		::std::condition_variable wake_;
+		bool stopping_ = false;
+
+		// written by the event loop
+		::std::atomic<uint64_t> heartbeat_ns_{0};
+		::std::atomic<int> event_type_{0};
+		::std::atomic<Window> window_{None};
+		// NextRequest() and LastKnownRequestProcessed() of the display
+		::std::atomic<unsigned long> next_request_{0};
+		::std::atomic<unsigned long> last_processed_{0};
+		::std::atomic<bool> idle_{false};
+		// set by the watchdog once a stall is reported, cleared by the loop
+		::std::atomic<bool> stalled_{false};
+
+		// stall statistics, updated by the event loop
+		::std::atomic<uint64_t> stalls_{0};
+		::std::atomic<uint64_t> stall_total_ns_{0};
+		::std::atomic<uint64_t> stall_max_ns_{0};
+};
+
+#endif
@@ -1,138 +1,1958 @@
 #include "window_manager.hpp"
 extern "C" {
+#include <X11/XKBlib.h>
+#include <X11/Xatom.h>
 #include <X11/Xutil.h>
+#include <X11/keysym.h>
 }
 #include <glog/logging.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
 #include <algorithm>
+#include <cstdlib>
+#include <gflags/gflags.h>
+#include "alloc_counter.hpp"
+#include "realtime.hpp"
+#include "tracing.hpp"
+#include "util.hpp"
 using ::std::string;
 using ::std::unique_ptr;
 
+namespace {
+
+// how often to retry selecting the root while replacing a window manager
+const int kRootRetryIntervalMs = 2;
+
+// _NET_WM_STATE bits worth restoring when an application maps again. only
+// states the window manager implements, so restoring never claims a state
+// nothing enforces
+const uint32_t kSessionStates = kImplementedStates;
+
+// returns the window an event is about. for SubstructureNotify and
+// SubstructureRedirect events that is not the window the event was
+// reported on
+Window EventWindow(const XEvent& e) {
+	switch (e.type) {
+		case CreateNotify:
+			return e.xcreatewindow.window;
+		case DestroyNotify:
+			return e.xdestroywindow.window;
+		case ReparentNotify:
+			return e.xreparent.window;
+		case MapRequest:
+			return e.xmaprequest.window;
+		case MapNotify:
+			return e.xmap.window;
+		case UnmapNotify:
+			return e.xunmap.window;
+		case ConfigureRequest:
+			return e.xconfigurerequest.window;
+		case ConfigureNotify:
+			return e.xconfigure.window;
+		default:
+			return e.xany.window;
+	}
+}
+
+// the server time in e, or CurrentTime for events without one
+Time EventTime(const XEvent& e) {
+	switch (e.type) {
+		case KeyPress:
+		case KeyRelease:
+			return e.xkey.time;
+		case ButtonPress:
+		case ButtonRelease:
+			return e.xbutton.time;
+		case MotionNotify:
+			return e.xmotion.time;
+		case EnterNotify:
+		case LeaveNotify:
+			return e.xcrossing.time;
+		case PropertyNotify:
+			return e.xproperty.time;
+		case SelectionClear:
+			return e.xselectionclear.time;
+		default:
+			return CurrentTime;
+	}
+}
+
+// events the window manager's bookkeeping depends on. plugins see them but
+// can't consume them
+bool IsStructural(int type) {
+	return type == CreateNotify || type == DestroyNotify || type == ReparentNotify ||
+		type == MapNotify || type == UnmapNotify || type == ConfigureNotify ||
+		type == SelectionClear;
+}
+
+// events a client causes by asking for something. the rest, such as
+// ConfigureNotify and UnmapNotify, often answer the window manager's own
+// requests and aren't the client's to pay for
+bool IsClientRequest(int type) {
+	return type == MapRequest || type == ConfigureRequest || type == ClientMessage ||
+		type == PropertyNotify;
+}
+
+// events a user waits on: input, new windows and focus changes
+bool IsLatencyCritical(int type) {
+	switch (type) {
+		case KeyPress:
+		case KeyRelease:
+		case ButtonPress:
+		case ButtonRelease:
+		case MotionNotify:
+		case EnterNotify:
+		case LeaveNotify:
+		case FocusIn:
+		case FocusOut:
+		case MapRequest:
+		case GenericEvent:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// the config file lives in ~/.config unless --config says otherwise
+string DefaultConfigPath() {
+	const char* config_home = getenv("XDG_CONFIG_HOME");
+	if (config_home != nullptr && config_home[0] != '\0') {
+		return string(config_home) + "/pulkras/config";
+	}
+	const char* home = getenv("HOME");
+	return string(home != nullptr ? home : ".") + "/.config/pulkras/config";
+}
+
+// the session database lives in ~/.cache unless --session_db says otherwise
+string DefaultSessionDbPath() {
+	const char* cache_home = getenv("XDG_CACHE_HOME");
+	if (cache_home != nullptr && cache_home[0] != '\0') {
+		return string(cache_home) + "/pulkras-session.db";
+	}
+	const char* home = getenv("HOME");
+	return string(home != nullptr ? home : ".") + "/.cache/pulkras-session.db";
+}
+
+// the flight recorder lives in ~/.cache unless --flight_recorder says
+// otherwise
+string DefaultFlightRecorderPath() {
+	const char* cache_home = getenv("XDG_CACHE_HOME");
+	if (cache_home != nullptr && cache_home[0] != '\0') {
+		return string(cache_home) + "/pulkras-flight.bin";
+	}
+	const char* home = getenv("HOME");
+	return string(home != nullptr ? home : ".") + "/.cache/pulkras-flight.bin";
+}
+
+// the flight recorder X errors and failed CHECKs are logged to. those are
+// reported through callbacks without a context pointer
+FlightRecorder* crash_recorder = nullptr;
+
+// glog's failure function, called after a fatal log message
+void OnCheckFailure() {
+	if (crash_recorder != nullptr) {
+		crash_recorder->Record(FlightKind::kAbort, 0, None, 0);
+	}
+	abort();
+}
+
+// timelines are dumped to $XDG_RUNTIME_DIR, or ~/.cache, unless
+// --timeline_path says otherwise
+string DefaultTimelinePath() {
+	const string name = "/pulkras-timeline-" + ::std::to_string(getpid()) + ".json";
+	const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+	if (runtime_dir != nullptr && runtime_dir[0] != '\0') {
+		return string(runtime_dir) + name;
+	}
+	const char* home = getenv("HOME");
+	return string(home != nullptr ? home : ".") + "/.cache" + name;
+}
+
+}  // namespace
+
+DEFINE_string(config, "", "path to the config file, ~/.config/pulkras/config if empty");
+DEFINE_string(rules, "", "path to the window rules file");
+DEFINE_bool(replace, false, "replace the running window manager");
+DEFINE_string(session_db, "",
+		"path to the session geometry database, ~/.cache/pulkras-session.db if empty");
+DEFINE_int32(replace_timeout_ms, 1000,
+		"how long to wait for the replaced window manager to exit");
+DEFINE_uint64(timeline_spans, 0,
+		"how many of the latest event loop spans to keep for SIGUSR2 dumps, 0 to disable");
+DEFINE_string(timeline_path, "",
+		"where SIGUSR2 dumps the timeline, pulkras-timeline-<pid>.json in $XDG_RUNTIME_DIR or ~/.cache if empty");
+DEFINE_uint64(stall_threshold_ms, 1000,
+		"log the event loop's stack when it spends longer than this on one event, 0 to disable");
+DEFINE_string(flight_recorder, "",
+		"path of the flight recorder ring, ~/.cache/pulkras-flight.bin if empty");
+DEFINE_uint32(flight_records, 65536, "how many records the flight recorder keeps, 0 to disable");
+DEFINE_double(client_event_rate, 200,
+		"events per second a client may cause before its ConfigureRequests are coalesced");
+DEFINE_double(client_event_burst, 400, "events a client may cause in a burst above its rate");
+DEFINE_int32(workspaces, 4, "number of workspaces");
+DEFINE_bool(focus_follows_mouse, false, "focus the window under the pointer");
+DEFINE_bool(click_to_focus, true, "focus and raise a window clicked with button 1");
+DEFINE_uint32(drag_modifier, Mod1Mask,
+		"modifier mask that moves windows with button 1 and resizes them with button 3, 0 for none");
+DEFINE_bool(xi2_drag, false, "drive drags with XInput2 raw motion rather than core motion");
+DEFINE_uint32(key_modifier, Mod4Mask,
+		"modifier mask that moves the focused window with the arrow keys, and resizes it with "
+		"Shift added. 0 for none");
+DEFINE_bool(group_keys, false,
+		"with --key_modifier, also bind Shift+Q to close the focused application and Z to stop "
+		"or continue its processes");
+DEFINE_uint32(key_step, 16, "pixels per arrow key press in keyboard moves and resizes");
+DEFINE_bool(minimal_event_masks, true,
+		"select only the events enabled features handle. unset to compare event volumes");
+DEFINE_uint32(adopt_slice_windows, 64,
+		"windows adopted per server grab at startup, 0 to adopt them all under one grab");
+DEFINE_uint32(adopt_slice_ms, 5, "time after which an adoption slice ends early, 0 for no limit");
+DEFINE_bool(realtime, false,
+		"lock memory, pre-size hot structures and raise the event thread's scheduling priority");
+DEFINE_int32(realtime_priority, 0,
+		"SCHED_FIFO priority of the event thread with --realtime, at most 98 as the watchdog runs "
+		"one above. 0 to only renice");
+DEFINE_int32(realtime_nice, -10, "nice level with --realtime, when SCHED_FIFO is off or not permitted");
+DEFINE_string(realtime_cpus, "", "CPUs to pin the event thread to with --realtime, like 2,4-5");
+DEFINE_uint32(expected_windows, 256, "windows to size hot structures and node pools for");
+DEFINE_bool(alloc_check, false,
+		"warn the first time each event type allocates on the heap after startup");
+DEFINE_uint32(latency_probe_ms, 0,
+		"wake up at least this often to measure scheduling latency, 0 to only measure real timers");
+DEFINE_string(plugins, "", "comma separated paths of plugins to load");
+DEFINE_uint64(plugin_budget_us, 50000,
+		"time a plugin may spend in its hooks per second before it is disabled, 0 for no limit");
+
+namespace {
+
+// flag validators, so a bad value stops the window manager at startup with
+// a message rather than misbehaving later
+bool ValidateFlightRecords(const char* flag, uint32_t value) {
+	if (value > FlightRecorder::kMaxCapacity) {
+		fprintf(stderr, "--%s must be at most %u\n", flag, FlightRecorder::kMaxCapacity);
+		return false;
+	}
+	return true;
+}
+const bool flight_records_validator =
+	::gflags::RegisterFlagValidator(&FLAGS_flight_records, &ValidateFlightRecords);
+
+}  // namespace
+
 bool WindowManager::wm_detected_;
+bool WindowManager::old_owner_gone_;
+
+unique_ptr<WindowManager> WindowManager::Create(const string& display_str) {
+	// first is open X display
+	const char* display_c_str = display_str.empty() ? nullptr : display_str.c_str();
+	Display* display = XOpenDisplay(display_c_str);
+	if (display == nullptr) {
+		LOG(ERROR) << "Failed to open X display " << XDisplayName(display_c_str);
+		return nullptr;
+	}
+	// second is construct WindowManager instance
+	return unique_ptr<WindowManager>(new WindowManager(display));
+}
+
+WindowManager::WindowManager(Display* display)
+	: display_(CHECK_NOTNULL(display)), 
+	  root_(DefaultRootWindow(display_)) {
+	atoms_.Intern(display_);
+
+	// the config is read once here, then reloaded off-thread on change
+	const string config_path = FLAGS_config.empty() ? DefaultConfigPath() : FLAGS_config;
+	Config* config = new Config();
+	ParseConfig(config_path, config);
+	config_.reset(config);
+	config_watcher_.Start(config_path);
+
+	if (!FLAGS_rules.empty() && !rules_.Load(FLAGS_rules)) {
+		LOG(ERROR) << "Failed to read window rules from " << FLAGS_rules;
+	}
+	session_db_.Open(FLAGS_session_db.empty() ? DefaultSessionDbPath() : FLAGS_session_db);
+
+	// SIGUSR1 and SIGUSR2 are read from a signalfd in the event loop
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGUSR1);
+	sigaddset(&signals, SIGUSR2);
+	CHECK_EQ(sigprocmask(SIG_BLOCK, &signals, nullptr), 0);
+	signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	CHECK_GE(signal_fd_, 0);
+
+	event_masks_ = ComputeEventMasks(ExtraEventTypes(), FLAGS_minimal_event_masks);
+	timeline_.Start(FLAGS_timeline_spans);
+	if (FLAGS_flight_records > 0 &&
+			flight_recorder_.Open(FLAGS_flight_recorder.empty() ?
+				DefaultFlightRecorderPath() : FLAGS_flight_recorder, FLAGS_flight_records)) {
+		crash_recorder = &flight_recorder_;
+		::google::InstallFailureFunction(&OnCheckFailure);
+	}
+	LoadPlugins();
+}
+
+WindowManager::~WindowManager() {
+	crash_recorder = nullptr;
+	// plugins may still use the display in their destroy hooks
+	plugins_.Unload();
+	close(signal_fd_);
+	XCloseDisplay(display_);
+}
+
+void WindowManager::Run() {
+	// first is initialization
+	// a. take the WM_Sn manager selection, replacing the current owner if
+	// asked to
+	XSetErrorHandler(&WindowManager::OnXError);
+	const uint64_t start_ms = MonotonicMs();
+	ReserveHotStructures(FLAGS_expected_windows);
+	// the watchdog starts before realtime mode, so its thread isn't pinned
+	// to the event thread's CPUs
+	watchdog_.Start(display_, FLAGS_stall_threshold_ms);
+	if (FLAGS_realtime) {
+		// SCHED_FIFO isn't inherited, so the watchdog gets its own priority,
+		// one above the event thread it has to preempt when it spins. that
+		// leaves the top priority to the watchdog
+		const int max_event_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+		RealtimeOptions options;
+		options.fifo_priority = FLAGS_realtime_priority;
+		if (options.fifo_priority > max_event_priority) {
+			LOG(WARNING) << "Lowering --realtime_priority to " << max_event_priority
+				<< ", so the watchdog can run above the event thread";
+			options.fifo_priority = max_event_priority;
+		}
+		options.nice = FLAGS_realtime_nice;
+		options.cpus = FLAGS_realtime_cpus;
+		if (EnterRealtimeMode(options)) {
+			watchdog_.SetFifoPriority(options.fifo_priority + 1);
+		}
+	}
+	drag_.Init(display_, root_, FLAGS_xi2_drag);
+	// waiting for the old window manager to let go is not a stall, and may
+	// take up to --replace_timeout_ms
+	watchdog_.Idle(MonotonicNs());
+	if (!AcquireManagerSelection(start_ms + FLAGS_replace_timeout_ms)) {
+		return;
+	}
+
+	// b. select events on root window
+	// we can exit if another window manager is already running. a window
+	// manager being replaced may hold on to the root for a moment after
+	// giving up the selection, so retry until the timeout
+	for (;;) {
+		wm_detected_ = false;
+		XSetErrorHandler(&WindowManager::OnWMDetected);
+		XSelectInput(display_, root_, event_masks_.root);
+		XSync(display_, false);
+		XSetErrorHandler(&WindowManager::OnXError);
+		if (!wm_detected_) {
+			break;
+		}
+		if (!FLAGS_replace || MonotonicMs() >= start_ms + FLAGS_replace_timeout_ms) {
+			LOG(ERROR) << "Detected another window manager on display" << XDisplayString(display_);
+			// gives up the selection too
+			XDestroyWindow(display_, check_window_);
+			check_window_ = None;
+			return;
+		}
+		poll(nullptr, 0, kRootRetryIntervalMs);
+	}
+	watchdog_.Busy(MonotonicNs());
+
+	// c. advertise EWMH support
+	workspace_count_ = ::std::max(1, FLAGS_workspaces);
+	SetupEwmh();
+	GrabKeys();
+
+	// d. frame exising top-level windows, a slice at a time
+	AdoptExistingWindows();
+	steady_state_ = true;
+	LOG(INFO) << "managing display " << XDisplayString(display_)
+		<< " after " << MonotonicMs() - start_ms << " ms";
+
+	// second is a main event loop
+	while (running_) {
+		// a. sleep until there is something to do
+		watchdog_.Idle(MonotonicNs());
+		WaitForEvents();
+		watchdog_.Busy(MonotonicNs());
+
+		// b. frame deferred windows that outlived the grace period
+		FrameExpiredDeferred(MonotonicMs());
+
+		// c. handle the queued events
+		RunBatch();
+
+		// d. stop selecting events nobody handles any more
+		if (plugins_.TakeSubscriptionsChanged()) {
+			UpdateEventMasks();
+		}
+
+		// e. swap in a reloaded config between batches
+		if (config_ready_) {
+			config_ready_ = false;
+			const bool timeline = timeline_.enabled();
+			const uint64_t reload_start_ns = timeline ? MonotonicNs() : 0;
+			const unsigned long reload_request = NextRequest(display_);
+			ReloadConfig();
+			if (timeline) {
+				timeline_.Record(SpanKind::kConfigReload, 0, None, reload_start_ns, MonotonicNs(),
+						NextRequest(display_) - reload_request);
+			}
+		}
+	}
+}
+
+void WindowManager::ReserveHotStructures(size_t windows) {
+	clients_.reserve(windows);
+	frames_.reserve(windows);
+	groups_.reserve(windows);
+	dirty_windows_.reserve(windows);
+	group_windows_.reserve(windows);
+	above_clients_.reserve(windows);
+	batch_.reserve(windows * 4);
+	bulk_.reserve(windows * 4);
+	held_windows_.reserve(windows * 4);
+	adopting_.reserve(windows);
+
+	// insert and drop placeholder entries, which leaves their nodes in the
+	// pools for the real ones
+	for (Window w = 1; w <= windows; w++) {
+		clients_[w];
+		frames_[w] = nullptr;
+	}
+	for (Window w = 1; w <= windows * 4; w++) {
+		held_windows_.insert(w);
+	}
+	clients_.clear();
+	frames_.clear();
+	held_windows_.clear();
+}
+
+void WindowManager::AdoptExistingWindows() {
+	const uint64_t adopt_start_ns = MonotonicNs();
+
+	// a. learn about windows reparented or destroyed while we adopt. a map
+	// or unmap needs nothing extra: a newly mapped window comes as a
+	// MapRequest, and Frame() skips windows no longer viewable
+	XSelectInput(display_, root_, event_masks_.root | SubstructureNotifyMask);
+
+	// b. query existing top-level windows
+	Window returned_root, returned_parent;
+	Window* top_level_windows;
+	unsigned int num_top_level_windows;
+	CHECK(XQueryTree(
+				display_,
+				root_,
+				&returned_root,
+				&returned_parent,
+				&top_level_windows,
+				&num_top_level_windows));
+	CHECK_EQ(returned_root, root_);
+	adopting_.insert(top_level_windows, top_level_windows + num_top_level_windows);
+
+	// c. frame them in slices, each under its own server grab. between
+	// slices the grab is released and queued events are handled, so
+	// nobody waits for the whole adoption
+	const size_t slice_windows = FLAGS_adopt_slice_windows > 0 ?
+		FLAGS_adopt_slice_windows : num_top_level_windows;
+	const uint64_t slice_budget_ns = static_cast<uint64_t>(FLAGS_adopt_slice_ms) * 1000000;
+	unsigned int next = 0;
+	while (next < num_top_level_windows) {
+		const uint64_t slice_start_ns = MonotonicNs();
+		const unsigned long slice_request = NextRequest(display_);
+		XGrabServer(display_);
+		for (size_t framed = 0; framed < slice_windows && next < num_top_level_windows; framed++) {
+			const Window w = top_level_windows[next++];
+			// gone, reparented away or managed through a MapRequest since
+			// the query
+			if (adopting_.erase(w) == 0 || clients_.count(w) != 0) {
+				continue;
+			}
+			Frame(w, true);
+			++metrics_.adopt_windows;
+			if (slice_budget_ns > 0 && MonotonicNs() - slice_start_ns >= slice_budget_ns) {
+				break;
+			}
+		}
+		XUngrabServer(display_);
+		CommitBatch();
+		XFlush(display_);
+
+		const uint64_t slice_end_ns = MonotonicNs();
+		++metrics_.adopt_slices;
+		metrics_.adopt_max_pause_ns = ::std::max(metrics_.adopt_max_pause_ns, slice_end_ns - slice_start_ns);
+		if (timeline_.enabled()) {
+			timeline_.Record(SpanKind::kGrab, 0, root_, slice_start_ns, slice_end_ns,
+					NextRequest(display_) - slice_request);
+		}
+
+		// d. let everyone else in
+		RunBatch();
+	}
+
+	// e. done
+	XFree(top_level_windows);
+	adopting_.clear();
+	XSelectInput(display_, root_, event_masks_.root);
+	metrics_.adopt_ns = MonotonicNs() - adopt_start_ns;
+	LOG(INFO) << "adopted " << metrics_.adopt_windows << " windows in " << metrics_.adopt_slices
+		<< " slices, " << metrics_.adopt_ns / 1000000 << " ms"
+		<< ", longest grab " << metrics_.adopt_max_pause_ns / 1000 << " us";
+}
+
+void WindowManager::RunBatch() {
+	// a. drain the queue, then dispatch the batch, latency-critical events
+	// first
+	const bool timeline = timeline_.enabled();
+	const uint64_t batch_start_ns = timeline ? MonotonicNs() : 0;
+	const unsigned long batch_request = NextRequest(display_);
+	batch_.clear();
+	while (XPending(display_)) {
+		batch_.emplace_back();
+		QueuedEvent& queued = batch_.back();
+		XNextEvent(display_, &queued.event);
+		queued.queued_ns = MonotonicNs();
+		// the next XNextEvent() would drop the data of a generic event
+		// nobody claimed yet
+		if (queued.event.type == GenericEvent) {
+			XGetEventData(display_, &queued.event.xcookie);
+		}
+		PULKRAS_TRACE3(event_receive, queued.event.type, queued.event.xany.window,
+				queued.event.xany.serial);
+	}
+	const uint64_t allocations = ThreadAllocations();
+	DispatchBatch();
+	const size_t batch_events = batch_.size();
+	for (QueuedEvent& queued : batch_) {
+		if (queued.event.type == GenericEvent) {
+			XFreeEventData(display_, &queued.event.xcookie);
+		}
+	}
+
+	// b. apply the changes the batch queued and send them
+	const uint64_t commit_start_ns = timeline ? MonotonicNs() : 0;
+	const unsigned long commit_request = NextRequest(display_);
+	const bool replayed = replay_pointer_;
+	CommitBatch();
+	if (batch_events > 0) {
+		++metrics_.batches;
+		if (ThreadAllocations() != allocations) {
+			++metrics_.batches_allocating;
+			metrics_.batch_allocations += ThreadAllocations() - allocations;
+		}
+	}
+	if (timeline) {
+		timeline_.Record(SpanKind::kCommit, 0, None, commit_start_ns, MonotonicNs(),
+				NextRequest(display_) - commit_request);
+	}
+	PULKRAS_TRACE1(flush_start, NextRequest(display_));
+	XFlush(display_);
+	PULKRAS_TRACE1(flush_end, NextRequest(display_));
+	if (drag_queued_ns_ != 0) {
+		const uint64_t drag_ns = MonotonicNs() - drag_queued_ns_;
+		drag_queued_ns_ = 0;
+		++metrics_.drag_updates;
+		metrics_.drag_to_flush_ns += drag_ns;
+		metrics_.drag_to_flush_max_ns = ::std::max(metrics_.drag_to_flush_max_ns, drag_ns);
+		++metrics_.drag_to_flush_buckets[LatencyBucket(drag_ns)];
+	}
+	if (replayed) {
+		const uint64_t click_ns = MonotonicNs() - replay_queued_ns_;
+		++metrics_.clicks_replayed;
+		metrics_.click_to_replay_ns += click_ns;
+		metrics_.click_to_replay_max_ns = ::std::max(metrics_.click_to_replay_max_ns, click_ns);
+		++metrics_.click_to_replay_buckets[LatencyBucket(click_ns)];
+	}
+	if (NextRequest(display_) != batch_request) {
+		flight_recorder_.Record(FlightKind::kFlush, 0, None, 0,
+				batch_request, NextRequest(display_) - 1);
+	}
+	if (timeline && batch_events > 0) {
+		timeline_.Record(SpanKind::kBatch, batch_events, None, batch_start_ns, MonotonicNs(),
+				NextRequest(display_) - batch_request);
+	}
+}
+
+void WindowManager::DispatchBatch() {
+	// a. input, new windows and focus changes go first, unless an event
+	// about the same window came before them and is still waiting. those
+	// keep their place, and hold back everything after them for that window
+	bulk_.clear();
+	held_windows_.clear();
+	for (size_t i = 0; i < batch_.size(); i++) {
+		const XEvent& e = batch_[i].event;
+		const Client* client = FindClient(EventWindow(e));
+		const Window window = client != nullptr ? client->window : EventWindow(e);
+		if (IsLatencyCritical(e.type) && held_windows_.count(window) == 0) {
+			if (!bulk_.empty()) {
+				++metrics_.events_prioritized;
+			}
+			HandleEvent(e, kEventCritical, batch_[i].queued_ns);
+		} else {
+			bulk_.push_back(i);
+			held_windows_.insert(window);
+		}
+	}
+
+	// b. everything else, in arrival order
+	for (size_t i : bulk_) {
+		const XEvent& e = batch_[i].event;
+		HandleEvent(e, IsLatencyCritical(e.type) ? kEventCritical : kEventBulk, batch_[i].queued_ns);
+	}
+}
+
+void WindowManager::HandleEvent(const XEvent& e, EventClass event_class, uint64_t queued_ns) {
+	const Window window = EventWindow(e);
+	const uint64_t start_ns = MonotonicNs();
+	watchdog_.Beat(e.type, window, start_ns);
+	flight_recorder_.Record(FlightKind::kEvent, e.type, window, e.xany.serial);
+	if (woke_ns_ != 0) {
+		const uint64_t wake_ns = start_ns - woke_ns_;
+		woke_ns_ = 0;
+		++metrics_.wake_dispatches;
+		metrics_.wake_to_dispatch_ns += wake_ns;
+		metrics_.wake_to_dispatch_max_ns = ::std::max(metrics_.wake_to_dispatch_max_ns, wake_ns);
+		++metrics_.wake_to_dispatch_buckets[LatencyBucket(wake_ns)];
+	}
+	// focus changes are stamped with the latest server time, so the server
+	// drops those overtaken by a newer one instead of letting them race.
+	// events may arrive out of time order, like synthetic ones carrying a
+	// stale stamp, so only move forward. server time is 32 bits and wraps
+	// after 49 days, hence the signed difference
+	const Time time = EventTime(e);
+	if (time != CurrentTime && (last_event_time_ == CurrentTime ||
+				static_cast<int32_t>(static_cast<uint32_t>(time - last_event_time_)) > 0)) {
+		last_event_time_ = time;
+	}
+	// a press through the click to focus grab froze the pointer, which has
+	// to be released even if a plugin consumes the press
+	if (e.type == ButtonPress && FLAGS_click_to_focus) {
+		replay_pointer_ = true;
+		replay_time_ = e.xbutton.time;
+		replay_queued_ns_ = queued_ns;
+	}
+	current_queued_ns_ = queued_ns;
+	const uint64_t wait_ns = start_ns - queued_ns;
+	++metrics_.events_by_class[event_class];
+	metrics_.queue_wait_ns[event_class] += wait_ns;
+	metrics_.queue_wait_max_ns[event_class] = ::std::max(metrics_.queue_wait_max_ns[event_class], wait_ns);
+
+	// clients flooding us get their ConfigureRequests coalesced
+	Client* client = FindClient(window);
+	if (client != nullptr && ThrottleEvent(client, e, start_ns)) {
+		return;
+	}
+
+	// time each handler when the timeline is recording
+	const unsigned long request = NextRequest(display_);
+	const uint64_t allocations = ThreadAllocations();
+	Dispatch(e);
+	const uint64_t event_allocations = ThreadAllocations() - allocations;
+	const unsigned long requests = NextRequest(display_) - request;
+	const uint64_t end_ns = MonotonicNs();
+	if (event_allocations > 0) {
+		CountEventAllocations(e, event_allocations);
+	}
+	flight_recorder_.Record(FlightKind::kHandled, e.type, window, e.xany.serial, requests);
+	if (timeline_.enabled()) {
+		timeline_.Record(SpanKind::kEvent, e.type, window, start_ns, end_ns, requests);
+	}
+	// the handler may have dropped the client
+	if (client != nullptr && (client = FindClient(window)) != nullptr) {
+		client->requests += requests;
+		client->handler_ns += end_ns - start_ns;
+	}
+}
+
+void WindowManager::ReloadConfig() {
+	::std::unique_ptr<const Config> config = config_watcher_.TakeSnapshot();
+	if (!config) {
+		return;
+	}
+	// nothing else holds on to the old snapshot, so it goes away at the end
+	// of this function
+	config_.swap(config);
+	const Config& old_config = *config;
+	const Config& new_config = *config_;
+	LOG(INFO) << "reloaded config";
+
+	// re-apply only what changed, to all frames in one batch
+	const bool border_width_changed = new_config.border_width != old_config.border_width;
+	const bool border_color_changed = new_config.border_color != old_config.border_color ||
+		new_config.focused_border_color != old_config.focused_border_color;
+	const bool background_changed = new_config.background_color != old_config.background_color;
+	if (!border_width_changed && !border_color_changed && !background_changed) {
+		return;
+	}
+	for (auto& entry : clients_) {
+		Client& client = entry.second;
+		if (client.frame == None) {
+			continue;
+		}
+		// a border width set by a rule stays
+		if (border_width_changed && client.rules.border_width < 0) {
+			if (client.fullscreen) {
+				client.saved_border_width = new_config.border_width;
+			} else {
+				XSetWindowBorderWidth(display_, client.frame, new_config.border_width);
+			}
+		}
+		if (border_color_changed) {
+			XSetWindowBorder(display_, client.frame, client.window == focused_ ?
+					new_config.focused_border_color : new_config.border_color);
+		}
+		if (background_changed) {
+			XSetWindowBackground(display_, client.frame, new_config.background_color);
+			XClearWindow(display_, client.frame);
+		}
+	}
+	XFlush(display_);
+}
+
+bool WindowManager::AcquireManagerSelection(uint64_t deadline_ms) {
+	const string selection_name = "WM_S" + ::std::to_string(DefaultScreen(display_));
+	manager_selection_ = XInternAtom(display_, selection_name.c_str(), False);
+
+	// a. the selection owner window doubles as _NET_SUPPORTING_WM_CHECK
+	check_window_ = XCreateSimpleWindow(display_, root_, -1, -1, 1, 1, 0, 0, 0);
+	auto fail = [this]() {
+		XDestroyWindow(display_, check_window_);
+		check_window_ = None;
+		return false;
+	};
+
+	Window old_owner = XGetSelectionOwner(display_, manager_selection_);
+	if (old_owner != None) {
+		if (!FLAGS_replace) {
+			LOG(ERROR) << "Another window manager owns " << selection_name
+				<< ", use --replace to replace it";
+			return fail();
+		}
+		// learn when the old owner is gone. if it went away since we asked,
+		// the select fails with BadWindow and no DestroyNotify will come
+		old_owner_gone_ = false;
+		XSetErrorHandler(&WindowManager::OnOldOwnerError);
+		XSelectInput(display_, old_owner, StructureNotifyMask);
+		XSync(display_, false);
+		XSetErrorHandler(&WindowManager::OnXError);
+		if (old_owner_gone_) {
+			old_owner = None;
+		}
+	}
+
+	// b. take the selection. ICCCM asks for a real timestamp, which we get
+	// from a zero-length property change on our own window
+	XSelectInput(display_, check_window_, PropertyChangeMask);
+	XChangeProperty(
+			display_,
+			check_window_,
+			atoms_[kNetWmName],
+			atoms_[kUtf8String],
+			8,
+			PropModeAppend,
+			nullptr,
+			0);
+	XEvent e;
+	XWindowEvent(display_, check_window_, PropertyChangeMask, &e);
+	XSelectInput(display_, check_window_, NoEventMask);
+	const Time timestamp = e.xproperty.time;
+
+	XSetSelectionOwner(display_, manager_selection_, check_window_, timestamp);
+	if (XGetSelectionOwner(display_, manager_selection_) != check_window_) {
+		LOG(ERROR) << "Failed to acquire " << selection_name;
+		return fail();
+	}
+
+	// c. wait for the old owner to destroy its window
+	if (old_owner != None) {
+		bool destroyed = false;
+		while (!(destroyed = XCheckTypedWindowEvent(display_, old_owner, DestroyNotify, &e))) {
+			const uint64_t now_ms = MonotonicMs();
+			if (now_ms >= deadline_ms) {
+				break;
+			}
+			pollfd fd;
+			fd.fd = ConnectionNumber(display_);
+			fd.events = POLLIN;
+			poll(&fd, 1, static_cast<int>(deadline_ms - now_ms));
+			// reads pending input into the queue
+			XPending(display_);
+		}
+		LOG_IF(WARNING, !destroyed) << "Previous window manager did not exit in time";
+	}
+
+	// d. announce the new manager
+	XEvent manager;
+	memset(&manager, 0, sizeof(manager));
+	manager.xclient.type = ClientMessage;
+	manager.xclient.window = root_;
+	manager.xclient.message_type = atoms_[kManager];
+	manager.xclient.format = 32;
+	manager.xclient.data.l[0] = timestamp;
+	manager.xclient.data.l[1] = manager_selection_;
+	manager.xclient.data.l[2] = check_window_;
+	XSendEvent(display_, root_, False, StructureNotifyMask, &manager);
+	return true;
+}
+
+void WindowManager::OnSelectionClear(const XSelectionClearEvent& e) {
+	if (e.selection != manager_selection_ || e.window != check_window_) {
+		return;
+	}
+	LOG(INFO) << "Replaced by another window manager, releasing clients";
+
+	// a. stop redirecting, so the new manager can select the root at once
+	XSelectInput(display_, root_, NoEventMask);
+
+	// b. hand every framed client back to the root where its frame was,
+	// from the cached geometry rather than a round trip per client. clients
+	// on hidden workspaces show up on the root too, which is what lets the
+	// new manager adopt them, and their _NET_WM_DESKTOP tells it where they
+	// belong
+	for (auto& entry : clients_) {
+		const Client& client = entry.second;
+		if (client.frame == None) {
+			continue;
+		}
+		const int x = client.fullscreen ? 0 : client.x;
+		const int y = client.fullscreen ? 0 : client.y;
+		XReparentWindow(display_, client.window, root_, x, y);
+		XRemoveFromSaveSet(display_, client.window);
+		XDestroyWindow(display_, client.frame);
+	}
+
+	// c. the new owner waits for this window to go away
+	XDestroyWindow(display_, check_window_);
+	XSync(display_, false);
+	running_ = false;
+}
+
+void WindowManager::WaitForEvents() {
+	if (XPending(display_)) {
+		return;
+	}
+
+	int timeout_ms = -1;
+	if (!deferred_.empty()) {
+		const uint64_t now_ms = MonotonicMs();
+		const uint64_t deadline_ms = deferred_.front().deadline_ms;
+		timeout_ms = deadline_ms > now_ms ? static_cast<int>(deadline_ms - now_ms) : 0;
+	}
+	if (FLAGS_latency_probe_ms > 0 &&
+			(timeout_ms < 0 || timeout_ms > static_cast<int>(FLAGS_latency_probe_ms))) {
+		timeout_ms = FLAGS_latency_probe_ms;
+	}
+	const uint64_t sleep_ns = MonotonicNs();
+
+	// negative fds, for a config that isn't watched, are ignored by poll
+	pollfd fds[4];
+	fds[0].fd = ConnectionNumber(display_);
+	fds[1].fd = signal_fd_;
+	fds[2].fd = config_watcher_.inotify_fd();
+	fds[3].fd = config_watcher_.ready_fd();
+	for (pollfd& fd : fds) {
+		fd.events = POLLIN;
+		fd.revents = 0;
+	}
+	const int ready = poll(fds, 4, timeout_ms);
+	if (ready < 0) {
+		PLOG_IF(WARNING, errno != EINTR) << "poll failed";
+		return;
+	}
+
+	// a timeout says how late the scheduler woke us. otherwise, time until
+	// the first event is dispatched
+	woke_ns_ = MonotonicNs();
+	if (ready == 0 && timeout_ms > 0) {
+		const uint64_t expected_ns = sleep_ns + static_cast<uint64_t>(timeout_ms) * 1000000;
+		const uint64_t late_ns = woke_ns_ > expected_ns ? woke_ns_ - expected_ns : 0;
+		++metrics_.timer_wakeups;
+		metrics_.timer_lateness_ns += late_ns;
+		metrics_.timer_lateness_max_ns = ::std::max(metrics_.timer_lateness_max_ns, late_ns);
+		++metrics_.timer_lateness_buckets[LatencyBucket(late_ns)];
+	}
+
+	if (fds[2].revents & POLLIN) {
+		config_watcher_.OnInotifyReadable();
+	}
+	if (fds[3].revents & POLLIN) {
+		config_ready_ = true;
+	}
+
+	if (fds[1].revents & POLLIN) {
+		signalfd_siginfo info;
+		while (read(signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+			if (info.ssi_signo == SIGUSR1) {
+				metrics_.Log();
+				plugins_.LogStats();
+				watchdog_.LogStats();
+				LogClientEvents();
+			} else if (info.ssi_signo == SIGUSR2) {
+				timeline_.Dump(FLAGS_timeline_path.empty() ?
+						DefaultTimelinePath() : FLAGS_timeline_path);
+			}
+		}
+	}
+}
+
+void WindowManager::Dispatch(const XEvent& e) {
+	VLOG(1) << "Received event: " << e.type;
+	PULKRAS_TRACE3(dispatch_start, e.type, EventWindow(e), e.xany.serial);
+	if (e.type >= 0 && e.type < LASTEvent) {
+		++metrics_.events[e.type];
+	}
+
+	// plugins see the event first, with a view of the client it is about
+	if (!plugins_.empty() &&
+			plugins_.Dispatch(e, FindClient(EventWindow(e))) &&
+			!IsStructural(e.type)) {
+		PULKRAS_TRACE3(dispatch_end, e.type, EventWindow(e), e.xany.serial);
+		return;
+	}
+
+	// dispatch event
+	switch (e.type) {
+		// the handlers of CreateNotify, ReparentNotify, MapNotify and
+		// ConfigureNotify do nothing, so these count as unhandled
+		case CreateNotify:
+			++metrics_.events_unhandled;
+		    OnCreateNotify(e.xcreatewindow);
+		    break;
+		case DestroyNotify:
+			OnDestroyNotify(e.xdestroywindow);
+			break;
+		case ReparentNotify:
+			++metrics_.events_unhandled;
+			OnReparentNotify(e.xreparent);
+			break;
+		case MapRequest:
+			OnMapRequest(e.xmaprequest);
+			break;
+		case MapNotify:
+			++metrics_.events_unhandled;
+			OnMapNotify(e.xmap);
+			break;
+		case UnmapNotify:
+			OnUnmapNotify(e.xunmap);
+			break;
+		case ConfigureRequest:
+			OnConfigureRequest(e.xconfigurerequest);
+			break;
+		case ConfigureNotify:
+			++metrics_.events_unhandled;
+			OnConfigureNotify(e.xconfigure);
+			break;
+		case EnterNotify:
+			OnEnterNotify(e.xcrossing);
+			break;
+		case ButtonPress:
+			OnButtonPress(e.xbutton);
+			break;
+		case ButtonRelease:
+			OnButtonRelease(e.xbutton);
+			break;
+		case MotionNotify:
+			OnMotionNotify(e.xmotion);
+			break;
+		case GenericEvent:
+			OnGenericEvent(e.xcookie);
+			break;
+		case KeyPress:
+			OnKeyPress(e.xkey);
+			break;
+		case KeyRelease:
+			OnKeyRelease(e.xkey);
+			break;
+		case MappingNotify:
+			OnMappingNotify(e.xmapping);
+			break;
+		case FocusIn:
+			OnFocusIn(e.xfocus);
+			break;
+		case ClientMessage:
+			OnClientMessage(e.xclient);
+			break;
+		case SelectionClear:
+			OnSelectionClear(e.xselectionclear);
+			break;
+		// etc. etc.
+		default:
+			++metrics_.events_unhandled;
+			VLOG(1) << "Ignored event";
+	}
+	PULKRAS_TRACE3(dispatch_end, e.type, EventWindow(e), e.xany.serial);
+}
+
+Client* WindowManager::FindClient(Window w) {
+	auto it = clients_.find(w);
+	if (it != clients_.end()) {
+		return &it->second;
+	}
+	auto frame = frames_.find(w);
+	return frame != frames_.end() ? frame->second : nullptr;
+}
+
+void WindowManager::LoadPlugins() {
+	plugin_host_.abi_version = PULKRAS_PLUGIN_ABI_VERSION;
+	plugin_host_.display = display_;
+	plugin_host_.context = this;
+	plugin_host_.raise = &WindowManager::PluginRaise;
+	plugin_host_.move_resize = &WindowManager::PluginMoveResize;
+	plugin_host_.activate = &WindowManager::PluginActivate;
+	plugin_host_.set_workspace = &WindowManager::PluginSetWorkspace;
+	plugin_host_.close = &WindowManager::PluginClose;
+	if (!FLAGS_plugins.empty()) {
+		plugins_.Load(FLAGS_plugins, plugin_host_, FLAGS_plugin_budget_us);
+	}
+}
+
+void WindowManager::PluginRaise(void* context, Window w) {
+	WindowManager* wm = static_cast<WindowManager*>(context);
+	if (Client* client = wm->FindClient(w)) {
+		wm->MarkDirty(client, kDirtyRaise);
+	}
+}
+
+void WindowManager::PluginMoveResize(void* context, Window w, int x, int y,
+		unsigned int width, unsigned int height) {
+	WindowManager* wm = static_cast<WindowManager*>(context);
+	if (Client* client = wm->FindClient(w)) {
+		client->pending_x = x;
+		client->pending_y = y;
+		client->pending_width = width;
+		client->pending_height = height;
+		client->pending_mask |= CWX | CWY | CWWidth | CWHeight;
+		wm->MarkDirty(client, kDirtyGeometry);
+	}
+}
+
+void WindowManager::PluginActivate(void* context, Window w, Time time) {
+	WindowManager* wm = static_cast<WindowManager*>(context);
+	if (Client* client = wm->FindClient(w)) {
+		wm->pending_active_ = client->window;
+		wm->pending_active_time_ = time;
+	}
+}
+
+void WindowManager::PluginSetWorkspace(void* context, Window w, int workspace) {
+	WindowManager* wm = static_cast<WindowManager*>(context);
+	Client* client = wm->FindClient(w);
+	if (client != nullptr && workspace >= 0 && workspace < wm->workspace_count_) {
+		wm->MoveGroupToWorkspace(client, workspace);
+	}
+}
+
+void WindowManager::PluginClose(void* context, Window w) {
+	WindowManager* wm = static_cast<WindowManager*>(context);
+	if (Client* client = wm->FindClient(w)) {
+		wm->CloseClient(client);
+	}
+}
+
+bool WindowManager::TakeEventToken(Client* client, uint64_t now_ns) {
+	const double burst = FLAGS_client_event_burst;
+	if (client->tokens_ns == 0) {
+		client->tokens = burst;
+	} else {
+		client->tokens = ::std::min(burst,
+				client->tokens + (now_ns - client->tokens_ns) * FLAGS_client_event_rate / 1e9);
+	}
+	client->tokens_ns = now_ns;
+	if (client->tokens < 1) {
+		return false;
+	}
+	client->tokens -= 1;
+	return true;
+}
+
+bool WindowManager::ThrottleEvent(Client* client, const XEvent& e, uint64_t now_ns) {
+	client->events++;
+	const bool over_budget = IsClientRequest(e.type) && !TakeEventToken(client, now_ns);
+	if (over_budget) {
+		client->events_over_budget++;
+		++metrics_.events_over_budget;
+	}
+	// only ConfigureRequests can be merged without losing anything. the
+	// later request wins for every field it sets. once one is merged, the
+	// rest of the batch's requests follow it, to keep them in order
+	if (e.type != ConfigureRequest || e.xconfigurerequest.window != client->window) {
+		return false;
+	}
+	if (!over_budget && !(client->dirty & kDirtyConfigure)) {
+		return false;
+	}
+	const XConfigureRequestEvent& request = e.xconfigurerequest;
+	XConfigureRequestEvent& merged = client->throttled_configure;
+	if (!(client->dirty & kDirtyConfigure)) {
+		merged = request;
+	} else {
+		client->configures_coalesced++;
+		++metrics_.configures_coalesced;
+		if (request.value_mask & CWX) {
+			merged.x = request.x;
+		}
+		if (request.value_mask & CWY) {
+			merged.y = request.y;
+		}
+		if (request.value_mask & CWWidth) {
+			merged.width = request.width;
+		}
+		if (request.value_mask & CWHeight) {
+			merged.height = request.height;
+		}
+		if (request.value_mask & CWBorderWidth) {
+			merged.border_width = request.border_width;
+		}
+		if (request.value_mask & CWSibling) {
+			merged.above = request.above;
+		}
+		if (request.value_mask & CWStackMode) {
+			merged.detail = request.detail;
+		}
+		merged.value_mask |= request.value_mask;
+	}
+	MarkDirty(client, kDirtyConfigure);
+	return true;
+}
+
+void WindowManager::LogClientEvents() const {
+	const size_t kTopClients = 5;
+	::std::vector<const Client*> top;
+	for (const auto& entry : clients_) {
+		top.push_back(&entry.second);
+	}
+	const size_t count = ::std::min(kTopClients, top.size());
+	::std::partial_sort(top.begin(), top.begin() + count, top.end(),
+			[](const Client* a, const Client* b) { return a->events > b->events; });
+	for (size_t i = 0; i < count; i++) {
+		const Client& client = *top[i];
+		LOG(INFO) << "client " << client.window << " (" << client.wm_class << "): "
+			<< client.events << " events"
+			<< ", " << client.requests << " requests"
+			<< ", " << client.handler_ns / 1000 << " us handling"
+			<< ", " << client.events_over_budget << " over budget"
+			<< ", " << client.configures_coalesced << " configures coalesced";
+	}
+}
+
+void WindowManager::CountEventAllocations(const XEvent& e, uint64_t allocations) {
+	++metrics_.allocating_events;
+	// extension events, like XInput2 GenericEvents, can be numbered past
+	// LASTEvent, and the reported mask has only 64 bits
+	if (e.type < 0 || e.type >= LASTEvent) {
+		return;
+	}
+	metrics_.event_allocations[e.type] += allocations;
+	static_assert(LASTEvent <= 64, "alloc_reported_ needs a bit per event type");
+	if (!FLAGS_alloc_check || !steady_state_ || (alloc_reported_ & (uint64_t(1) << e.type))) {
+		return;
+	}
+	alloc_reported_ |= uint64_t(1) << e.type;
+	LOG(WARNING) << EventTypeName(e.type) << " for window " << EventWindow(e)
+		<< " made " << allocations << " heap allocations";
+}
+
+uint64_t WindowManager::ExtraEventTypes() const {
+	uint64_t event_types = plugins_.event_types();
+	if (FLAGS_focus_follows_mouse) {
+		event_types |= uint64_t(1) << EnterNotify;
+	}
+	return event_types;
+}
+
+void WindowManager::UpdateEventMasks() {
+	const EventMasks masks = ComputeEventMasks(ExtraEventTypes(), FLAGS_minimal_event_masks);
+	if (masks == event_masks_) {
+		return;
+	}
+	event_masks_ = masks;
+	XSelectInput(display_, root_, masks.root);
+	for (const auto& entry : clients_) {
+		const Client& client = entry.second;
+		if (client.frame != None) {
+			XSelectInput(display_, client.frame, masks.frame);
+			XSelectInput(display_, client.window, masks.client);
+		} else if (client.policy == FramePolicy::kDefer) {
+			XSelectInput(display_, client.window, masks.deferred_client);
+		} else {
+			XSelectInput(display_, client.window, masks.unframed_client);
+		}
+	}
+	LOG(INFO) << "updated event masks";
+}
+
+void WindowManager::OnCreateNotify(const XCreateWindowEvent& e) {}
+
+void WindowManager::OnDestroyNotify(const XDestroyWindowEvent& e) {
+	adopting_.erase(e.window);
+	// a deferred window may be destroyed without being unmapped first
+	auto it = clients_.find(e.window);
+	if (it == clients_.end() || it->second.frame != None) {
+		return;
+	}
+	if (it->second.policy == FramePolicy::kDefer) {
+		++metrics_.frames_avoided;
+	}
+	RemoveClient(e.window);
+}
+
+void WindowManager::OnReparentNotify(const XReparentEvent& e) {
+	// a window reparented away mid-adoption isn't top-level any more
+	if (e.parent != root_) {
+		adopting_.erase(e.window);
+	}
+}
+
+void WindowManager::OnMapRequest(const XMapRequestEvent& e) {
+	auto it = clients_.find(e.window);
+	if (it == clients_.end()) {
+		// classify window from its cached properties
+		Client& client = AddClient(e.window);
+		client.policy = ClassifyWindow(atoms_, client.traits);
+
+		switch (client.policy) {
+			case FramePolicy::kFrameNow:
+				Frame(e.window, false);
+				break;
+			case FramePolicy::kDefer:
+				// watch for interaction, frame later if it is still around
+				XSelectInput(display_, e.window, event_masks_.deferred_client);
+				deferred_.push_back({e.window, MonotonicMs() + config_->deferred_frame_grace_ms});
+				++metrics_.frames_deferred;
+				VLOG(1) << "deferred framing of window " << e.window;
+				break;
+			case FramePolicy::kNoFrame:
+				XSelectInput(display_, e.window, event_masks_.unframed_client);
+				++metrics_.windows_unframed;
+				break;
+		}
+
+		// a new dialog goes on top of its application. any new window maps
+		// on top, over the clients kept above
+		client.raised = ++raises_;
+		restack_above_ = true;
+		if (client.transient_parent != nullptr) {
+			RaiseGroup(&client);
+		}
+	}
+	// map window
+	XMapWindow(display_, e.window);
+}
+
+Client& WindowManager::AddClient(Window w) {
+	Client& client = clients_[w];
+	client.window = w;
+	client.traits = ReadWindowTraits(display_, atoms_, w);
+	LinkClient(&client);
+	return client;
+}
+
+void WindowManager::RemoveClient(Window w) {
+	auto it = clients_.find(w);
+	if (it == clients_.end()) {
+		return;
+	}
+	UnlinkClient(&it->second);
+	if (it->second.frame != None) {
+		frames_.erase(it->second.frame);
+	}
+	if (focused_ == w) {
+		focused_ = None;
+	}
+	if (pending_focus_.window() == w) {
+		pending_focus_.Clear();
+	}
+	if (drag_.window() == w) {
+		drag_.End();
+	}
+	// the record goes back to its slab, and its arena releases the strings
+	// in one go
+	clients_.erase(it);
+}
+
+void WindowManager::LinkClient(Client* client) {
+	// a. attach to the transient parent, or wait for it to be managed
+	const Window parent_window = client->traits.transient_for;
+	if (parent_window != None && parent_window != client->window) {
+		auto parent = clients_.find(parent_window);
+		if (parent != clients_.end()) {
+			if (!AttachTransient(&parent->second, client)) {
+				LOG(WARNING) << "ignoring WM_TRANSIENT_FOR cycle through window " << client->window;
+			}
+		} else {
+			pending_transients_.emplace(parent_window, client);
+		}
+	}
+
+	// b. adopt transients that were managed before this client
+	auto range = pending_transients_.equal_range(client->window);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (!AttachTransient(client, it->second)) {
+			LOG(WARNING) << "ignoring WM_TRANSIENT_FOR cycle through window " << it->second->window;
+		}
+	}
+	pending_transients_.erase(range.first, range.second);
+
+	// c. join the leader group
+	client->group_next = client->group_prev = client;
+	const Window leader = client->traits.leader;
+	if (leader != None) {
+		auto group = groups_.find(leader);
+		if (group != groups_.end()) {
+			Client* head = group->second;
+			client->group_next = head;
+			client->group_prev = head->group_prev;
+			head->group_prev->group_next = client;
+			head->group_prev = client;
+		} else {
+			groups_.emplace(leader, client);
+		}
+	}
+}
+
+void WindowManager::UnlinkClient(Client* client) {
+	// a. detach from the transient parent
+	if (client->transient_parent != nullptr) {
+		if (client->prev_transient != nullptr) {
+			client->prev_transient->next_transient = client->next_transient;
+		} else {
+			client->transient_parent->first_transient = client->next_transient;
+		}
+		if (client->next_transient != nullptr) {
+			client->next_transient->prev_transient = client->prev_transient;
+		}
+	} else if (client->traits.transient_for != None) {
+		auto range = pending_transients_.equal_range(client->traits.transient_for);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == client) {
+				pending_transients_.erase(it);
+				break;
+			}
+		}
+	}
+
+	// b. orphaned transients wait for this window to be managed again
+	for (Client* child = client->first_transient; child != nullptr; child = child->next_transient) {
+		child->transient_parent = nullptr;
+		pending_transients_.emplace(client->window, child);
+	}
+
+	// c. leave the leader group
+	if (client->group_next != nullptr) {
+		client->group_prev->group_next = client->group_next;
+		client->group_next->group_prev = client->group_prev;
+		auto group = groups_.find(client->traits.leader);
+		if (group != groups_.end() && group->second == client) {
+			if (client->group_next != client) {
+				group->second = client->group_next;
+			} else {
+				groups_.erase(group);
+			}
+		}
+	}
+}
 
-unique_ptr<WindowManager> WindowManager::Create() {
-	// first is open X display
-	Display* display = XOpenDisplay(nullptr);
-	if (display == nullptr) {
-		LOG(ERROR) << "Failed to open X display" << XDisplayName(nullptr);
-		return nullptr;
+void WindowManager::RaiseGroup(Client* client) {
+	// collect frames bottom to top, then raise the top one and restack the
+	// rest under it, two requests however big the group
+	group_windows_.clear();
+	ForEachInGroup(client, [this](Client* member) {
+		group_windows_.push_back(member->frame != None ? member->frame : member->window);
+		member->raised = ++raises_;
+	});
+	::std::reverse(group_windows_.begin(), group_windows_.end());
+	XRaiseWindow(display_, group_windows_.front());
+	if (group_windows_.size() > 1) {
+		XRestackWindows(display_, group_windows_.data(), group_windows_.size());
 	}
-	// second is construct WindowManager instance
-	return unique_ptr<WindowManager>(new WindowManager(display));
+	restack_above_ = true;
 }
 
-WindowManager::WindowManager(Display* display)
-	: display_(CHECK_NOTNULL(display)), 
-	  root_(DefaultRootWindow(display_)) {
+void WindowManager::RaiseAboveClients() {
+	const uint32_t above = 1u << kStateAbove;
+	above_clients_.clear();
+	for (auto& entry : clients_) {
+		if (entry.second.net_state & above) {
+			above_clients_.push_back(&entry.second);
+		}
+	}
+	if (above_clients_.empty()) {
+		return;
+	}
+	// top to bottom, the last raised first
+	::std::sort(above_clients_.begin(), above_clients_.end(), [](const Client* a, const Client* b) {
+		return a->raised > b->raised;
+	});
+	group_windows_.clear();
+	for (const Client* client : above_clients_) {
+		group_windows_.push_back(client->frame != None ? client->frame : client->window);
+	}
+	XRaiseWindow(display_, group_windows_.front());
+	if (group_windows_.size() > 1) {
+		XRestackWindows(display_, group_windows_.data(), group_windows_.size());
+	}
 }
 
-WindowManager::~WindowManager() {
-	XCloseDisplay(display_);
+void WindowManager::MoveGroupToWorkspace(Client* client, int workspace) {
+	ForEachInGroup(client, [this, workspace](Client* member) {
+		// unmapping an unframed window would withdraw it
+		if (member->workspace == workspace || member->frame == None) {
+			return;
+		}
+		member->workspace = workspace;
+		WriteNetWmDesktop(member);
+		if (workspace == current_workspace_) {
+			XMapWindow(display_, member->frame);
+		} else {
+			XUnmapWindow(display_, member->frame);
+		}
+	});
 }
 
-void WindowManager::Run() {
-	// first is initialization
-	// a. select events on root window
-	// we can exit if another window manager is already running
-	wm_detected_ = false;
-	XSetErrorHandler(&WindowManager::OnWMDetected);
-	XSelectInput(
+void WindowManager::FreezeGroup(Client* client, bool freeze) {
+	const pid_t self = getpid();
+	pid_t last_pid = 0;
+	ForEachInGroup(client, [&](Client* member) {
+		member->frozen = freeze;
+		// the pid is whatever the client claims, so never signal init or
+		// the window manager itself
+		const pid_t pid = member->traits.pid;
+		if (pid <= 1 || pid == self) {
+			return;
+		}
+		// members of an application mostly share a process
+		if (pid != last_pid) {
+			kill(pid, freeze ? SIGSTOP : SIGCONT);
+			last_pid = pid;
+		}
+	});
+}
+
+void WindowManager::CloseGroup(Client* client) {
+	ForEachInGroup(client, [this](Client* member) {
+		CloseClient(member);
+	});
+}
+
+void WindowManager::CloseClient(Client* client) {
+	// ask politely if the client supports WM_DELETE_WINDOW, as of MapRequest
+	if (client->traits.delete_window) {
+		SendProtocol(client, atoms_[kWmDeleteWindow], last_event_time_);
+	} else {
+		XKillClient(display_, client->window);
+	}
+}
+
+void WindowManager::SendProtocol(Client* client, Atom protocol, Time time) {
+	XEvent msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.xclient.type = ClientMessage;
+	msg.xclient.window = client->window;
+	msg.xclient.message_type = atoms_[kWmProtocols];
+	msg.xclient.format = 32;
+	msg.xclient.data.l[0] = protocol;
+	msg.xclient.data.l[1] = time;
+	XSendEvent(display_, client->window, False, NoEventMask, &msg);
+}
+
+void WindowManager::SwitchWorkspace(int workspace) {
+	if (workspace == current_workspace_) {
+		return;
+	}
+	for (auto& entry : clients_) {
+		const Client& client = entry.second;
+		if (client.frame == None) {
+			continue;
+		}
+		if (client.workspace == workspace) {
+			XMapWindow(display_, client.frame);
+		} else if (client.workspace == current_workspace_) {
+			XUnmapWindow(display_, client.frame);
+		}
+	}
+	current_workspace_ = workspace;
+
+	const long value = workspace;
+	XChangeProperty(
 			display_,
 			root_,
-			SubstructureRedirectMask | SubstructureNotifyMask);
-	XSync(display_, false);
-	if (wm_detected_) {
-		LOG(ERROR) << "Detected another window manager on display" << XDisplayString(display_);
+			atoms_[kNetCurrentDesktop],
+			XA_CARDINAL,
+			32,
+			PropModeReplace,
+			reinterpret_cast<const unsigned char*>(&value),
+			1);
+}
+
+void WindowManager::MarkDirty(Client* client, uint32_t flags) {
+	if (client->dirty == 0) {
+		dirty_windows_.push_back(client->window);
+	}
+	client->dirty |= flags;
+}
+
+void WindowManager::CommitBatch() {
+	// a. per-client changes, each applied once however often it was queued
+	for (Window w : dirty_windows_) {
+		auto it = clients_.find(w);
+		if (it == clients_.end()) {
+			continue;
+		}
+		Client& client = it->second;
+		const uint32_t dirty = client.dirty;
+		client.dirty = 0;
+
+		if (dirty & kDirtyState) {
+			const bool fullscreen = client.net_state & (1u << kStateFullscreen);
+			if (fullscreen != client.fullscreen) {
+				SetFullscreen(&client, fullscreen);
+			}
+			WriteNetWmState(&client);
+		}
+		if ((dirty & kDirtyGeometry) && client.fullscreen) {
+			// fullscreen geometry wins. dropping the request keeps it from
+			// merging into one queued after leaving fullscreen
+			client.pending_mask = 0;
+		} else if (dirty & kDirtyGeometry) {
+			XWindowChanges changes;
+			changes.x = client.pending_x;
+			changes.y = client.pending_y;
+			changes.width = client.pending_width;
+			changes.height = client.pending_height;
+			if (client.pending_mask & CWX) {
+				client.x = changes.x;
+			}
+			if (client.pending_mask & CWY) {
+				client.y = changes.y;
+			}
+			if (client.pending_mask & CWWidth) {
+				client.width = changes.width;
+			}
+			if (client.pending_mask & CWHeight) {
+				client.height = changes.height;
+			}
+			if (client.frame != None) {
+				XConfigureWindow(display_, client.frame, client.pending_mask, &changes);
+				XConfigureWindow(
+						display_,
+						client.window,
+						client.pending_mask & (CWWidth | CWHeight),
+						&changes);
+				// moving the frame moves the client without the server
+				// telling it, so tell it, as ICCCM 4.1.5 requires
+				if (!(client.pending_mask & (CWWidth | CWHeight))) {
+					SendSyntheticConfigure(&client);
+				}
+			} else {
+				XConfigureWindow(display_, client.window, client.pending_mask, &changes);
+			}
+			client.pending_mask = 0;
+		}
+		if (dirty & kDirtyRaise) {
+			RaiseGroup(&client);
+		}
+		if (dirty & kDirtyConfigure) {
+			OnConfigureRequest(client.throttled_configure);
+		}
+	}
+	dirty_windows_.clear();
+
+	// b. activation, which overrides focus following the pointer
+	if (pending_active_ != None) {
+		auto it = clients_.find(pending_active_);
+		if (it != clients_.end()) {
+			Client& client = it->second;
+			SwitchWorkspace(client.workspace);
+			RaiseGroup(&client);
+			FocusClient(&client, pending_active_time_);
+		}
+		pending_active_ = None;
+		pending_focus_.Clear();
+	}
+
+	// c. focus follows the last window the pointer entered
+	if (pending_focus_.window() != None) {
+		auto it = clients_.find(pending_focus_.window());
+		if (it != clients_.end() && it->second.window != focused_) {
+			FocusClient(&it->second, pending_focus_.time());
+		}
+		pending_focus_.Clear();
+	}
+
+	// d. keep the clients in _NET_WM_STATE_ABOVE over whatever this batch
+	// raised, with one restack however many raises there were
+	if (restack_above_) {
+		RaiseAboveClients();
+		restack_above_ = false;
+	}
+
+	// e. let the click through, in the same flush as the focus and raise
+	if (replay_pointer_) {
+		XAllowEvents(display_, ReplayPointer, replay_time_);
+		replay_pointer_ = false;
+	}
+}
+
+void WindowManager::FocusClient(Client* client, Time time) {
+	const FocusModel model = FocusModelOf(client->traits);
+	if (model == FocusModel::kNoInput) {
+		++metrics_.focus_refused;
 		return;
 	}
-	// b. set error handler
-	XSetErrorHandler(&WindowManager::OnXError);
+	if (time == CurrentTime) {
+		time = last_event_time_;
+	}
+	if (model != FocusModel::kGloballyActive) {
+		XSetInputFocus(display_, client->window, RevertToPointerRoot, time);
+	}
+	if (model != FocusModel::kPassive) {
+		SendProtocol(client, atoms_[kWmTakeFocus], time);
+	}
+	++metrics_.focus_by_model[static_cast<int>(model)];
+	if (client->window != focused_) {
+		// clicks on the focused frame go straight to the client, the
+		// others are caught to focus theirs first
+		const Config& config = *config_;
+		auto it = clients_.find(focused_);
+		if (it != clients_.end() && it->second.frame != None) {
+			XSetWindowBorder(display_, it->second.frame, config.border_color);
+			GrabFrameButtons(it->second.frame, false);
+		}
+		if (client->frame != None) {
+			XSetWindowBorder(display_, client->frame, config.focused_border_color);
+			GrabFrameButtons(client->frame, true);
+		}
+		focused_ = client->window;
+		++metrics_.focus_changes;
+	}
+	XChangeProperty(
+			display_,
+			root_,
+			atoms_[kNetActiveWindow],
+			XA_WINDOW,
+			32,
+			PropModeReplace,
+			reinterpret_cast<const unsigned char*>(&client->window),
+			1);
+}
 
-	// c. grab X server to prevent windows from other window managers
-	XGrabServer(display_);
+void WindowManager::PromoteDeferred(Window w) {
+	auto it = clients_.find(w);
+	if (it == clients_.end() || it->second.frame != None ||
+			it->second.policy != FramePolicy::kDefer) {
+		return;
+	}
+	XSelectInput(display_, w, NoEventMask);
+	Frame(w, false);
+}
 
-	// d. frame exising top-level windows
-	
-	// 1. uery existing top-level windows
-	Window returned_root, returned_parent;
-	Window* top_level_windows;
-	unsigned int num_top_level_windows;
-	CHECK(XQueryTree(
+void WindowManager::FrameExpiredDeferred(uint64_t now_ms) {
+	while (!deferred_.empty() && deferred_.front().deadline_ms <= now_ms) {
+		const Window w = deferred_.front().window;
+		deferred_.pop_front();
+		auto it = clients_.find(w);
+		if (it != clients_.end() && it->second.frame == None &&
+				it->second.policy == FramePolicy::kDefer) {
+			++metrics_.frames_promoted_timeout;
+			PromoteDeferred(w);
+		}
+	}
+}
+
+void WindowManager::OnEnterNotify(const XCrossingEvent& e) {
+	auto it = clients_.find(e.window);
+	if (it != clients_.end() && it->second.frame == None &&
+			it->second.policy == FramePolicy::kDefer) {
+		++metrics_.frames_promoted_interaction;
+		PromoteDeferred(e.window);
+		return;
+	}
+
+	// focus follows the pointer into frames. crossings caused by grabs, and
+	// the pointer coming back from the client to the frame border, don't
+	// move it. virtual crossings do: the client fills the frame, so a
+	// pointer jumping onto a client only reports a virtual crossing here
+	if (!FLAGS_focus_follows_mouse) {
+		return;
+	}
+	auto frame = frames_.find(e.window);
+	if (frame == frames_.end()) {
+		return;
+	}
+	++metrics_.focus_crossings;
+	if (e.mode != NotifyNormal || e.detail == NotifyInferior) {
+		++metrics_.focus_crossings_filtered;
+		return;
+	}
+	// only the last crossing read in the batch takes effect
+	pending_focus_.Offer(frame->second->window, e.time, current_queued_ns_);
+}
+
+void WindowManager::GrabFrameButtons(Window frame, bool focused) {
+	// a. click to focus
+	if (FLAGS_click_to_focus && !focused) {
+		XGrabButton(
 				display_,
-				root_,
-				&returned_root,
-				&returned_parent,
-				&top_level_windows,
-				&num_top_level_windows));
-	CHECK_EQ(returned_root, root_);
+				Button1,
+				AnyModifier,
+				frame,
+				False,
+				ButtonPressMask,
+				GrabModeSync,
+				GrabModeAsync,
+				None,
+				None);
+	} else if (FLAGS_click_to_focus) {
+		XUngrabButton(display_, Button1, AnyModifier, frame);
+	}
 
-	// 2. frame each top-level window
-	for (unsigned int i = 0; i < num_top_level_windows; i++) {
-		Frame(top_level_windows[i], true);
+	// b. drags, asynchronous, with or without Caps Lock and Num Lock. these
+	// replace the AnyModifier grab for their modifier combinations
+	if (FLAGS_drag_modifier == 0) {
+		return;
+	}
+	const unsigned int kLocks[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
+	for (unsigned int button : {Button1, Button3}) {
+		for (unsigned int locks : kLocks) {
+			XGrabButton(
+					display_,
+					button,
+					FLAGS_drag_modifier | locks,
+					frame,
+					False,
+					ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
+					GrabModeAsync,
+					GrabModeAsync,
+					None,
+					None);
+		}
 	}
+}
 
-	// 3. free top-level window array
-	XFree(top_level_windows);
+void WindowManager::OnButtonPress(const XButtonEvent& e) {
+	auto frame = frames_.find(e.window);
+	if (frame == frames_.end()) {
+		return;
+	}
+	Client* client = frame->second;
 
-	// e. ungrap X server
-	XUngramServer(display_);
+	// a. the drag grab, with the modifier held
+	const bool drag = FLAGS_drag_modifier != 0 && (e.state & FLAGS_drag_modifier) == FLAGS_drag_modifier &&
+		(e.button == Button1 || e.button == Button3);
+	if (drag && !drag_.active() && !client->fullscreen) {
+		drag_.Begin(e.button == Button1 ? DragMode::kMove : DragMode::kResize, client->window,
+				e.x_root, e.y_root, client->x, client->y, client->width, client->height);
+		++metrics_.drags;
+		// raw motion replaces core motion for the rest of the grab
+		if (drag_.uses_xi2()) {
+			XChangeActivePointerGrab(display_, ButtonReleaseMask, None, e.time);
+		}
+	}
 
-	// second is a main event loop
-	for (;;) {
-		// get next event
-		XEvent e;
-		XNextEvent(display_, &e);
-		LOG(INFO) << "Received event: ";
-
-		// dispatch event
-		switch (e.type) {
-			case CreateNotify:
-			    OnCreateNotify(e.xcreatewindow);
-			    break;
-			case DestroyNotify:
-				OnDestroyNotify(e.xdestroywindow);
-				break;
-			case ReparentNotify:
-				OnReparentNotify(e.xreparent);
-				break;
-			case MapRequest:
-				OnMapRequest(e.xmaprequest);
-				break;
-			case MapNotify:
-				OnMapNotify(e.xmap);
-				break;
-			case UnmapNotify:
-				OnUnmapNotify(e.xunmap);
-				break;
-			case ConfigureRequest:
-				OnConfigureRequest(e.xconfigurerequest);
-				break;
-			case ConfigureNotify:
-				OnConfigureNotify(e.xconfigure);
-				break;
-			// etc. etc.
-			default:
-				LOG(WARNING) << "Ignored event";
+	// b. the click to focus grab. the pointer is frozen until the batch
+	// commit replays the press
+	if (FLAGS_click_to_focus && (e.button == Button1 || drag)) {
+		pending_active_ = client->window;
+		pending_active_time_ = e.time;
+	}
+}
+
+void WindowManager::OnButtonRelease(const XButtonEvent& e) {
+	// the grab, and with it the drag, ends once no button is held. the
+	// state still has the button being released
+	const unsigned int buttons =
+		e.state & (Button1Mask | Button2Mask | Button3Mask | Button4Mask | Button5Mask);
+	if (drag_.active() && buttons == (static_cast<unsigned int>(Button1Mask) << (e.button - 1))) {
+		drag_.End();
+	}
+}
+
+void WindowManager::OnMotionNotify(const XMotionEvent& e) {
+	if (drag_.OnMotion(e)) {
+		++metrics_.drag_core_motion;
+		ApplyDrag();
+	}
+}
+
+void WindowManager::OnGenericEvent(const XGenericEventCookie& cookie) {
+	if (drag_.OnGenericEvent(cookie)) {
+		++metrics_.drag_raw_motion;
+		ApplyDrag();
+	}
+}
+
+void WindowManager::GrabKeys() {
+	XUngrabKey(display_, AnyKey, AnyModifier, root_);
+	// releases of keys held across a regrab may never arrive, and a stale
+	// bit would swallow the next press as a repeat
+	keys_down_ = 0;
+	if (FLAGS_key_modifier == 0) {
+		return;
+	}
+	// held keys repeat as presses alone, rather than release and press
+	// pairs, which tells repeats from new presses
+	Bool supported = False;
+	XkbSetDetectableAutoRepeat(display_, True, &supported);
+	if (!supported) {
+		LOG(WARNING) << "Detectable autorepeat not supported, key repeats count as presses";
+	}
+
+	const unsigned int kLocks[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
+	auto grab = [this, &kLocks](KeyCode keycode, unsigned int modifiers) {
+		if (keycode == 0) {
+			return;
+		}
+		for (unsigned int locks : kLocks) {
+			XGrabKey(display_, keycode, modifiers | locks, root_, True, GrabModeAsync, GrabModeAsync);
 		}
+	};
+
+	// a. arrows move, and resize with Shift
+	const KeySym kArrows[kArrowKeys] = {XK_Left, XK_Right, XK_Up, XK_Down};
+	for (int i = 0; i < kArrowKeys; i++) {
+		arrow_keycodes_[i] = XKeysymToKeycode(display_, kArrows[i]);
+		grab(arrow_keycodes_[i], FLAGS_key_modifier);
+		grab(arrow_keycodes_[i], FLAGS_key_modifier | ShiftMask);
+	}
+
+	// b. Shift+Q closes the focused application, Z freezes or thaws it
+	close_keycode_ = freeze_keycode_ = 0;
+	if (!FLAGS_group_keys) {
+		return;
 	}
+	close_keycode_ = XKeysymToKeycode(display_, XK_q);
+	grab(close_keycode_, FLAGS_key_modifier | ShiftMask);
+	freeze_keycode_ = XKeysymToKeycode(display_, XK_z);
+	grab(freeze_keycode_, FLAGS_key_modifier);
 }
 
-void WindowManager::OnCreateNotify(const XCreateWindowEvent& e) {}
-void WindowManager::OnDestroyNofity(const XDestroyWindowEvent& e) {}
-void WindowManager::OnReparentNotify(const XReparentEvent& e) {}
+void WindowManager::OnKeyPress(const XKeyEvent& e) {
+	if (FLAGS_key_modifier != 0 && (e.state & FLAGS_key_modifier) == FLAGS_key_modifier &&
+			(e.keycode == close_keycode_ || e.keycode == freeze_keycode_)) {
+		OnGroupKey(e);
+		return;
+	}
+	int key = 0;
+	while (key < kArrowKeys && arrow_keycodes_[key] != e.keycode) {
+		key++;
+	}
+	if (key == kArrowKeys || FLAGS_key_modifier == 0 ||
+			(e.state & FLAGS_key_modifier) != FLAGS_key_modifier) {
+		return;
+	}
+	++metrics_.key_presses;
+	if (keys_down_ & (1u << key)) {
+		++metrics_.key_repeats;
+	}
+	keys_down_ |= 1u << key;
 
-void WindowManager::OnMapRequest(const XMapRequestEvent& e) {
-	// frame or reframe window
-	Frame(e.window, false);
-	// map window
-	XMapWindow(display_, e.window);
+	auto it = clients_.find(focused_);
+	if (it == clients_.end() || it->second.fullscreen) {
+		return;
+	}
+	Client& client = it->second;
+	// a. the step, in the order of kArrows
+	const int step = FLAGS_key_step;
+	const int dx = key == 0 ? -step : key == 1 ? step : 0;
+	const int dy = key == 2 ? -step : key == 3 ? step : 0;
+
+	// b. add it to the geometry pending for the commit, so every press
+	// and repeat of the batch makes a single configure of frame and client.
+	// a move alone gets its synthetic ConfigureNotify there too
+	if (client.dirty & kDirtyGeometry) {
+		++metrics_.key_presses_coalesced;
+	}
+	if (e.state & ShiftMask) {
+		const int width = (client.pending_mask & CWWidth) ? client.pending_width : client.width;
+		const int height = (client.pending_mask & CWHeight) ? client.pending_height : client.height;
+		client.pending_width = ::std::max(1, width + dx);
+		client.pending_height = ::std::max(1, height + dy);
+		client.pending_mask |= CWWidth | CWHeight;
+	} else {
+		client.pending_x = ((client.pending_mask & CWX) ? client.pending_x : client.x) + dx;
+		client.pending_y = ((client.pending_mask & CWY) ? client.pending_y : client.y) + dy;
+		client.pending_mask |= CWX | CWY;
+	}
+	MarkDirty(&client, kDirtyGeometry);
+}
+
+void WindowManager::OnGroupKey(const XKeyEvent& e) {
+	auto it = clients_.find(focused_);
+	if (it == clients_.end()) {
+		return;
+	}
+	Client* client = &it->second;
+	if (e.keycode == close_keycode_ && (e.state & ShiftMask)) {
+		CloseGroup(client);
+	} else if (e.keycode == freeze_keycode_ && !(e.state & ShiftMask)) {
+		FreezeGroup(client, !client->frozen);
+	}
+}
+
+void WindowManager::OnKeyRelease(const XKeyEvent& e) {
+	for (int key = 0; key < kArrowKeys; key++) {
+		if (arrow_keycodes_[key] == e.keycode) {
+			keys_down_ &= ~(1u << key);
+		}
+	}
+}
+
+void WindowManager::OnMappingNotify(XMappingEvent e) {
+	XRefreshKeyboardMapping(&e);
+	if (e.request == MappingKeyboard || e.request == MappingModifier) {
+		GrabKeys();
+	}
+}
+
+void WindowManager::ApplyDrag() {
+	auto it = clients_.find(drag_.window());
+	if (it == clients_.end()) {
+		drag_.End();
+		return;
+	}
+	if (drag_queued_ns_ == 0) {
+		drag_queued_ns_ = current_queued_ns_;
+	}
+	Client& client = it->second;
+	client.pending_x = drag_.x();
+	client.pending_y = drag_.y();
+	client.pending_width = drag_.width();
+	client.pending_height = drag_.height();
+	client.pending_mask |= drag_.mode() == DragMode::kMove ? (CWX | CWY) : (CWWidth | CWHeight);
+	MarkDirty(&client, kDirtyGeometry);
+}
+
+void WindowManager::OnFocusIn(const XFocusChangeEvent& e) {
+	auto it = clients_.find(e.window);
+	if (it != clients_.end() && it->second.frame == None &&
+			it->second.policy == FramePolicy::kDefer) {
+		++metrics_.frames_promoted_interaction;
+		PromoteDeferred(e.window);
+	}
 }
 
 void WindowManager::OnMapNotify(const XMapEvent& e) {}
 void WindowManager::OnUnmapNotify(const XUnmapEvent& e) {
 	// if it is a client window, unmap it
-	if (!clients_.count(e.window)) {
-		LOG(INFO) << "ignore UnmapNotify for non-client window " << e.window;
+	auto it = clients_.find(e.window);
+	if (it == clients_.end()) {
+		VLOG(1) << "ignore UnmapNotify for non-client window " << e.window;
+		return;
+	}
+
+	// an unframed client is a child of the root, so this is a real unmap
+	if (it->second.frame == None) {
+		if (it->second.policy == FramePolicy::kDefer) {
+			++metrics_.frames_avoided;
+		}
+		RemoveClient(e.window);
 		return;
 	}
 
@@ -144,41 +1964,139 @@ void WindowManager::OnUnmapNotify(const XUnmapEvent& e) {
 	Unframe(e.window);
 }
 
-void WindowManager::Frame(Window w) {
+void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
+	PULKRAS_TRACE1(frame_start, w);
 	// visual properties fo the frame to create it
-	const unsigned int BORDER_WIDTH = 3;
-	const unsigned long BORDER_COLOR = 0xffff00;
-	const unsigned long BG_COLOR = 0x0000ff;
+	const Config& config = *config_;
 
 	// retrieve attributes
+	// the window may already be gone when framing was deferred
 	XWindowAttributes x_window_attrs;
-	CHECK(XGetWindowAttributes(display_, w, &x_window_attrs));
+	if (!XGetWindowAttributes(display_, w, &x_window_attrs)) {
+		LOG(WARNING) << "failed to get attributes of window " << w;
+		RemoveClient(w);
+		PULKRAS_TRACE2(frame_end, w, None);
+		return;
+	}
 
 	// if window was created before window manager started, we should frame 
 	// it only if it is visible and doesn't set override_redirect
 	if (was_created_before_window_manager) {
 		if (x_window_attrs.override_redirect || x_window_attrs.map_state != IsViewable) {
+			PULKRAS_TRACE2(frame_end, w, None);
 			return;
 		}
 	}
 	
+	// match window rules against the cached class, role and title
+	auto it = clients_.find(w);
+	Client& client = it != clients_.end() ? it->second : AddClient(w);
+	ReadRuleProperties(&client);
+	const uint64_t match_start_ns = MonotonicNs();
+	client.rules = rules_.Match({
+			client.wm_class,
+			client.wm_instance,
+			client.wm_role,
+			client.wm_title});
+	metrics_.rule_match_ns += MonotonicNs() - match_start_ns;
+	++metrics_.rule_matches;
+	if (client.rules.num_matched > 0) {
+		++metrics_.rule_matched_windows;
+	}
+	if (client.rules.no_frame) {
+		client.policy = FramePolicy::kNoFrame;
+		XSelectInput(display_, w, event_masks_.unframed_client);
+		++metrics_.windows_unframed;
+		PULKRAS_TRACE2(frame_end, w, None);
+		return;
+	}
+	if (client.rules.workspace >= 0 && client.transient_parent == nullptr) {
+		client.workspace = client.rules.workspace;
+	}
+	const unsigned int border_width = client.rules.border_width >= 0 ?
+		client.rules.border_width : config.border_width;
+
+	// place frame
+	int x = x_window_attrs.x;
+	int y = x_window_attrs.y;
+	if (client.rules.placement != Placement::kClient) {
+		const int screen = DefaultScreen(display_);
+		int center_x = DisplayWidth(display_, screen) / 2;
+		int center_y = DisplayHeight(display_, screen) / 2;
+		if (client.rules.placement == Placement::kPointer) {
+			Window returned_root, returned_child;
+			int window_x, window_y;
+			unsigned int mask;
+			XQueryPointer(
+					display_,
+					root_,
+					&returned_root,
+					&returned_child,
+					&center_x,
+					&center_y,
+					&window_x,
+					&window_y,
+					&mask);
+		}
+		x = ::std::max(0, center_x - x_window_attrs.width / 2 - static_cast<int>(border_width));
+		y = ::std::max(0, center_y - x_window_attrs.height / 2 - static_cast<int>(border_width));
+	}
+
+	// restore where the application was last time, unless the rules say
+	// otherwise. dialogs follow their parent instead. windows we adopt are
+	// already where the user left them, so they keep their geometry, and
+	// only have it stored when they go away
+	unsigned int width = x_window_attrs.width;
+	unsigned int height = x_window_attrs.height;
+	SessionRecord session;
+	if (client.wm_class[0] != '\0' && client.transient_parent == nullptr) {
+		client.session_key = SessionDb::Key(client.wm_class, client.wm_instance, client.wm_role);
+		if (!was_created_before_window_manager) {
+			if (SessionKeyAmbiguous(client)) {
+				++metrics_.session_ambiguous;
+			} else if (session_db_.Lookup(client.session_key, &session)) {
+				++metrics_.session_hits;
+				if (client.rules.placement == Placement::kClient) {
+					x = session.x;
+					y = session.y;
+				}
+				if (session.width > 0 && session.height > 0) {
+					width = session.width;
+					height = session.height;
+					XResizeWindow(display_, w, width, height);
+				}
+				if (client.rules.workspace < 0) {
+					client.workspace = session.workspace;
+				}
+			} else {
+				++metrics_.session_misses;
+			}
+		}
+	}
+	client.x = x;
+	client.y = y;
+	client.width = width;
+	client.height = height;
+
 	// create frame
 	const Window frame = XCreateSimpleWindow(
 			display_,
 			root_,
-			x_window_attrs.x,
-			x_window_attrs.y,
-			x_window_attrs.width,
-			x_window_attrs.height,
-			BORDER_WIDTH,
-			BORDER_COLOR,
-			BG_COLOR);
-
-	// select events on frame
-	XselectInput(
-			display_,
-			frame,
-			SubstructureRedirectMask | SubstructureNotifyMask);
+			x,
+			y,
+			width,
+			height,
+			border_width,
+			config.border_color,
+			config.background_color);
+
+	// select events on frame, and on the client if anything needs them
+	XSelectInput(display_, frame, event_masks_.frame);
+	if (event_masks_.client != NoEventMask) {
+		XSelectInput(display_, w, event_masks_.client);
+	}
+
+	GrabFrameButtons(frame, false);
 
 	// add client to save set
 	XAddToSaveSet(display_, w);
@@ -190,11 +2108,19 @@ void WindowManager::Frame(Window w) {
 			frame,
 			0, 0); // offset of client window within frame
 
-	// map frame
-	XMapWindow(display_, frame);
+	// map frame, unless the rules put it on another workspace
+	if (client.workspace >= workspace_count_) {
+		client.workspace = current_workspace_;
+	}
+	WriteNetWmDesktop(&client);
+	if (client.workspace == current_workspace_) {
+		XMapWindow(display_, frame);
+	}
 
 	// save frame handle
-	clients_[w] = frame;
+	client.frame = frame;
+	frames_[frame] = &client;
+	++metrics_.frames_created;
 
 	// grab events for window management actions on client window
 	// a. Move windows with ...
@@ -206,12 +2132,90 @@ void WindowManager::Frame(Window w) {
 	// switch windows with ...
 	// XGrabKey(...)
 	
-	LOG(INFO) << "framed window " << w << " [" << frame << "]";
+	VLOG(1) << "framed window " << w << " [" << frame << "]";
+
+	// honor states set before the window was mapped, and those it had last
+	// session
+	client.net_state = ReadNetWmState(w) | (session.state & kSessionStates);
+	if (client.net_state != 0) {
+		MarkDirty(&client, kDirtyState);
+	}
+	flight_recorder_.Record(FlightKind::kFrame, 0, w, 0, frame);
+	PULKRAS_TRACE2(frame_end, w, frame);
+}
+
+void WindowManager::ReadRuleProperties(Client* client) {
+	// the strings go to the client's arena, and are released with it
+	Arena& arena = client->arena;
+	arena.Reset();
+	client->wm_class = client->wm_instance = client->wm_role = client->wm_title = "";
+	auto copy = [&arena](const char* s) -> const char* {
+		return s != nullptr ? arena.CopyString(s, strlen(s)) : "";
+	};
+
+	// WM_CLASS
+	XClassHint class_hint;
+	if (XGetClassHint(display_, client->window, &class_hint)) {
+		client->wm_instance = copy(class_hint.res_name);
+		client->wm_class = copy(class_hint.res_class);
+		XFree(class_hint.res_name);
+		XFree(class_hint.res_class);
+	}
+
+	// WM_WINDOW_ROLE
+	XTextProperty text;
+	if (XGetTextProperty(display_, client->window, &text, atoms_[kWmWindowRole])) {
+		if (text.value != nullptr) {
+			client->wm_role = copy(reinterpret_cast<const char*>(text.value));
+			XFree(text.value);
+		}
+	}
+
+	// _NET_WM_NAME, falling back to WM_NAME
+	if (XGetTextProperty(display_, client->window, &text, atoms_[kNetWmName]) ||
+			XGetWMName(display_, client->window, &text)) {
+		if (text.value != nullptr) {
+			client->wm_title = copy(reinterpret_cast<const char*>(text.value));
+			XFree(text.value);
+		}
+	}
+}
+
+bool WindowManager::SessionKeyAmbiguous(const Client& client) const {
+	// a role tells an application's windows apart. without one, windows of
+	// an application open at the same time would share a record, so none of
+	// them restores or stores it
+	if (client.wm_role[0] != '\0') {
+		return false;
+	}
+	for (const auto& entry : clients_) {
+		if (&entry.second != &client && entry.second.session_key == client.session_key) {
+			return true;
+		}
+	}
+	return false;
 }
 
 void WindowManager::Unframe(Window w) {
+	PULKRAS_TRACE1(unframe_start, w);
+	// remember the geometry for the next time the application maps it
+	const Client& client = clients_[w];
+	if (client.session_key != 0 && SessionKeyAmbiguous(client)) {
+		++metrics_.session_ambiguous;
+	} else if (client.session_key != 0) {
+		SessionRecord session;
+		session.x = client.fullscreen ? client.saved_x : client.x;
+		session.y = client.fullscreen ? client.saved_y : client.y;
+		session.width = client.fullscreen ? client.saved_width : client.width;
+		session.height = client.fullscreen ? client.saved_height : client.height;
+		session.workspace = client.workspace;
+		session.state = client.net_state & kSessionStates;
+		session_db_.Store(client.session_key, session);
+		++metrics_.session_writes;
+	}
+
 	// we reverse the steps taken in Frame() function
-	const Window frame = clients_[w];
+	const Window frame = client.frame;
 	// unmap frame
 	XUnmapWindow(display_, frame);
 	
@@ -224,17 +2228,29 @@ void WindowManager::Unframe(Window w) {
 
 	// remove client window from save set
 	XRemoveFromSaveSet(display_, w);
+	if (event_masks_.client != NoEventMask) {
+		XSelectInput(display_, w, NoEventMask);
+	}
 
 	// destroy frame
 	XDestroyWindow(display_, frame);
 
 	//drop reference to frame handle
-	clients.erase(w);
+	RemoveClient(w);
 
-	LOG(INFO) << "unframed window " << w << " [" << frame << "]";
+	VLOG(1) << "unframed window " << w << " [" << frame << "]";
+	flight_recorder_.Record(FlightKind::kUnframe, 0, w, 0);
+	PULKRAS_TRACE1(unframe_end, w);
 }
 
 void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e) {
+	// fullscreen windows keep their geometry, so there is nothing to forward
+	auto it = clients_.find(e.window);
+	if (it != clients_.end() && it->second.fullscreen) {
+		SendSyntheticConfigure(&it->second);
+		return;
+	}
+
 	XWindowChanges changes;
 	// copy fields from e to changes
 	changes.x = e.x;
@@ -245,16 +2261,124 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e) {
 	changes.sibling = e.above;
 	changes.stack_mode = e.detail;
 
-	if (clients_.count(e.window)) {
-		const Window frame = clients_[e.window];
+	if (e.value_mask & CWStackMode) {
+		if (it != clients_.end() && e.detail == Above) {
+			it->second.raised = ++raises_;
+		}
+		restack_above_ = true;
+	}
+	if (it != clients_.end() && it->second.frame != None) {
+		const Window frame = it->second.frame;
 		XConfigureWindow(display_, frame, e.value_mask, &changes);
-		LOG(INFO) << "resize [" << frame << "] to " << Size<int>(e.width, e.height);
+		Client& client = it->second;
+		if (e.value_mask & CWX) {
+			client.x = e.x;
+		}
+		if (e.value_mask & CWY) {
+			client.y = e.y;
+		}
+		if (e.value_mask & CWWidth) {
+			client.width = e.width;
+		}
+		if (e.value_mask & CWHeight) {
+			client.height = e.height;
+		}
+		VLOG(1) << "resize [" << frame << "] to " << Size<int>(e.width, e.height);
 	}
 
 	//grant request by calling XConfigureWindow()
 	XConfigureWindow(display_, e.window, e.value_mask, &changes);
-	LOG(INFO) << "Resize " << e.window << " to " << Size<int>(e.width, e.height);
+	VLOG(1) << "Resize " << e.window << " to " << Size<int>(e.width, e.height);
+}
+void WindowManager::SetFullscreen(Client* client, bool fullscreen) {
+	if (client->fullscreen == fullscreen) {
+		return;
+	}
+	const Window outer = client->frame != None ? client->frame : client->window;
+
+	XWindowChanges changes;
+	if (fullscreen) {
+		// remember where the frame was
+		Window returned_root;
+		unsigned int depth;
+		if (!XGetGeometry(
+					display_,
+					outer,
+					&returned_root,
+					&client->saved_x,
+					&client->saved_y,
+					&client->saved_width,
+					&client->saved_height,
+					&client->saved_border_width,
+					&depth)) {
+			return;
+		}
+		const int screen = DefaultScreen(display_);
+		changes.x = 0;
+		changes.y = 0;
+		changes.width = DisplayWidth(display_, screen);
+		changes.height = DisplayHeight(display_, screen);
+		changes.border_width = 0;
+	} else {
+		changes.x = client->saved_x;
+		changes.y = client->saved_y;
+		changes.width = client->saved_width;
+		changes.height = client->saved_height;
+		changes.border_width = client->saved_border_width;
+	}
+	changes.stack_mode = Above;
+
+	// move, resize, drop the border and raise the frame in one request
+	XConfigureWindow(
+			display_,
+			outer,
+			CWX | CWY | CWWidth | CWHeight | CWBorderWidth | CWStackMode,
+			&changes);
+	if (client->frame != None) {
+		XResizeWindow(display_, client->window, changes.width, changes.height);
+	}
+	client->fullscreen = fullscreen;
+	client->raised = ++raises_;
+	restack_above_ = true;
+
+	LOG(INFO) << (fullscreen ? "entered" : "left") << " fullscreen for window " << client->window;
+}
+
+void WindowManager::SendSyntheticConfigure(Client* client) {
+	XEvent notify;
+	memset(&notify, 0, sizeof(notify));
+	notify.xconfigure.type = ConfigureNotify;
+	notify.xconfigure.event = client->window;
+	notify.xconfigure.window = client->window;
+	if (client->fullscreen) {
+		const int screen = DefaultScreen(display_);
+		notify.xconfigure.x = 0;
+		notify.xconfigure.y = 0;
+		notify.xconfigure.width = DisplayWidth(display_, screen);
+		notify.xconfigure.height = DisplayHeight(display_, screen);
+	} else {
+		// root coordinates of the client, inside the frame border
+		const int border = client->rules.border_width >= 0 ?
+			client->rules.border_width : config_->border_width;
+		notify.xconfigure.x = client->x + border;
+		notify.xconfigure.y = client->y + border;
+		notify.xconfigure.width = client->width;
+		notify.xconfigure.height = client->height;
+	}
+	notify.xconfigure.border_width = 0;
+	notify.xconfigure.above = None;
+	notify.xconfigure.override_redirect = False;
+	XSendEvent(display_, client->window, False, StructureNotifyMask, &notify);
+}
+
+int WindowManager::OnOldOwnerError(Display* display, XErrorEvent* e) {
+	if (e->error_code == BadWindow) {
+		old_owner_gone_ = true;
+		return 0;
+	}
+	return OnXError(display, e);
 }
+
 int WindowManager::OnWMDetected(Display* display, XErrorEvent* e) {
 	// XselectInput is BadAccess. we don't expect this handler to receive other errors
 	CHECK_EQ(static_cast<int>(e->error_code), BadAccess);
@@ -266,5 +2390,18 @@ int WindowManager::OnWMDetected(Display* display, XErrorEvent* e) {
 
 void WindowManager::OnConfigureNotify(const XConfigureEvent& e) {}
 
-int WindowManager::OnXError(Display* display, XErrorEvent* e) { /* print e */}
+int WindowManager::OnXError(Display* display, XErrorEvent* e) {
+	PULKRAS_TRACE4(x_error, e->error_code, e->request_code, e->resourceid, e->serial);
+	if (crash_recorder != nullptr) {
+		crash_recorder->Record(FlightKind::kXError, e->error_code, e->resourceid, e->serial,
+				e->request_code);
+	}
+	char error_text[256];
+	XGetErrorText(display, e->error_code, error_text, sizeof(error_text));
+	LOG(ERROR) << "received X error: request " << static_cast<int>(e->request_code)
+		<< ", error " << error_text
+		<< ", resource " << e->resourceid;
+	// the error handler's return value is ignored
+	return 0;
+}
 
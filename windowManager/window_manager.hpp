@@ -4,17 +4,34 @@
 extern "C" {
 #include <X11/Xlib.h>
 }
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include "atoms.hpp"
+#include "client.hpp"
+#include "config.hpp"
+#include "crossing.hpp"
+#include "drag.hpp"
+#include "event_masks.hpp"
+#include "ewmh.hpp"
+#include "flight_recorder.hpp"
+#include "metrics.hpp"
+#include "plugins.hpp"
+#include "pool_allocator.hpp"
+#include "session_db.hpp"
+#include "timeline.hpp"
+#include "watchdog.hpp"
+#include "window_rules.hpp"
 class WindowManager {
 	public:
 		// estabilish connection to an X server
 		// creating a WindowManager instance
 
 		static ::std::unique_ptr<WindowManager> Create(
-				const std::string& display_str = std::string()
-		};
+				const std::string& display_str = std::string());
 
 		// disconnect from the X server
 		~WindowManager();
@@ -29,24 +46,293 @@ class WindowManager {
 		void Frame(Window w, bool was_created_before_window_manager);
 		// unframes a clinet window
 		void Unframe(Window w);
+		// whether another client has client's session key and neither has a
+		// role to tell them apart
+		bool SessionKeyAmbiguous(const Client& client) const;
+		// caches the strings window rules match on in client
+		void ReadRuleProperties(Client* client);
+
+		// creates the record of a newly managed window and links it into its
+		// transient tree and leader group
+		Client& AddClient(Window w);
+		// unlinks and drops the record of w
+		void RemoveClient(Window w);
+		void LinkClient(Client* client);
+		void UnlinkClient(Client* client);
+
+		// operations on the whole application a client belongs to. each costs
+		// O(group size) and issues its requests as one batch
+		void RaiseGroup(Client* client);
+		// raises the clients in _NET_WM_STATE_ABOVE over all the others, in
+		// the order they were last raised
+		void RaiseAboveClients();
+		void MoveGroupToWorkspace(Client* client, int workspace);
+		// stops or continues the processes of a group, via _NET_WM_PID
+		void FreezeGroup(Client* client, bool freeze);
+		void CloseGroup(Client* client);
+		// asks client to close, or kills it without WM_DELETE_WINDOW
+		void CloseClient(Client* client);
+		// maps the frames of workspace and unmaps those of the current one
+		void SwitchWorkspace(int workspace);
+
+		// queues flags for the next CommitBatch()
+		void MarkDirty(Client* client, uint32_t flags);
+		// focuses client the way its ICCCM input model asks for, gives it the
+		// focused border and publishes it as _NET_ACTIVE_WINDOW. time is the
+		// server time of the triggering event, CurrentTime for the last one
+		// seen. called from CommitBatch() only, costs no round trip
+		void FocusClient(Client* client, Time time);
+		// sends a WM_PROTOCOLS message
+		void SendProtocol(Client* client, Atom protocol, Time time);
+		// X event types handled beyond the core set, for ComputeEventMasks()
+		uint64_t ExtraEventTypes() const;
+		// applies the X changes queued while dispatching a batch of events
+		void CommitBatch();
+
+		// enters or leaves fullscreen. the frame is kept but loses its border
+		// and is moved, resized and raised with a single ConfigureWindow
+		void SetFullscreen(Client* client, bool fullscreen);
+		// tells the client its current geometry in root coordinates, as
+		// ICCCM requires when a request is not granted or the frame moved
+		// without resizing the client
+		void SendSyntheticConfigure(Client* client);
+
+		// EWMH support. see ewmh.cpp
+		// advertises the supported hints and builds the dispatch tables
+		void SetupEwmh();
+		// reads _NET_WM_STATE of w as a bitset of NetStateBit
+		uint32_t ReadNetWmState(Window w);
+		void WriteNetWmState(Client* client);
+		// publishes the client's workspace as _NET_WM_DESKTOP
+		void WriteNetWmDesktop(Client* client);
+		// client message handlers, indexed by ClientMessageType. client is
+		// null when the message isn't about a managed window
+		typedef void (WindowManager::*MessageHandler)(Client* client, const XClientMessageEvent& e);
+		static const MessageHandler kMessageHandlers[kClientMessageCount];
+		void OnActiveWindowMessage(Client* client, const XClientMessageEvent& e);
+		void OnWmStateMessage(Client* client, const XClientMessageEvent& e);
+		void OnMoveResizeWindowMessage(Client* client, const XClientMessageEvent& e);
+		void OnCloseWindowMessage(Client* client, const XClientMessageEvent& e);
+		void OnWmDesktopMessage(Client* client, const XClientMessageEvent& e);
+		void OnCurrentDesktopMessage(Client* client, const XClientMessageEvent& e);
+
+		// blocks until X events are queued, the next deferred frame is due,
+		// the config changed or a signal arrives
+		void WaitForEvents();
+		// swaps in a reloaded config snapshot and re-applies what changed
+		void ReloadConfig();
+		// sizes the containers touched per event for windows clients, and
+		// fills their node pools, so they don't allocate in steady state
+		void ReserveHotStructures(size_t windows);
+		// frames the windows that existed before us, in slices under short
+		// server grabs, handling events in between
+		void AdoptExistingWindows();
+		// drains and handles the queued events, then commits and flushes
+		// what they changed
+		void RunBatch();
+		// dispatches the drained batch_, latency-critical events first
+		void DispatchBatch();
+		// accounts for e, then dispatches it unless it is throttled.
+		// queued_ns is when it was read off the queue
+		void HandleEvent(const XEvent& e, EventClass event_class, uint64_t queued_ns);
+		// dispatches a single event to its handler
+		void Dispatch(const XEvent& e);
+		// the client an event is about, by client or frame window, or null
+		Client* FindClient(Window w);
+
+		// pulkras_host services handed to plugins. context is the
+		// WindowManager
+		void LoadPlugins();
+		static void PluginRaise(void* context, Window w);
+		static void PluginMoveResize(void* context, Window w, int x, int y,
+				unsigned int width, unsigned int height);
+		static void PluginActivate(void* context, Window w, Time time);
+		static void PluginSetWorkspace(void* context, Window w, int workspace);
+		static void PluginClose(void* context, Window w);
+
+		// takes the ICCCM WM_Sn manager selection. with --replace, takes it
+		// from the current owner and waits until deadline_ms for it to exit
+		bool AcquireManagerSelection(uint64_t deadline_ms);
+		// another window manager took the selection: hands the clients back
+		// and leaves the event loop
+		void OnSelectionClear(const XSelectionClearEvent& e);
+
+		// recomputes the event masks and reselects them where they changed
+		void UpdateEventMasks();
+
+		// charges an event to client's budget. returns false if the client is
+		// over budget
+		bool TakeEventToken(Client* client, uint64_t now_ns);
+		// counts e against client, and charges it if the client asked for it
+		// (see IsClientRequest). while the client is over budget, its
+		// ConfigureRequests are merged and applied once at the batch commit,
+		// other events pass. returns true if the event was absorbed
+		bool ThrottleEvent(Client* client, const XEvent& e, uint64_t now_ns);
+		// logs the clients causing the most events
+		void LogClientEvents() const;
+		// accounts heap allocations made handling e, and reports them with
+		// --alloc_check once startup is over
+		void CountEventAllocations(const XEvent& e, uint64_t allocations);
+
+		// frames a window whose framing was deferred
+		void PromoteDeferred(Window w);
+		// frames deferred windows that outlived their grace period
+		void FrameExpiredDeferred(uint64_t now_ms);
 
 		// event handlers
-		void OnCreateNotify(const XcreateWindowEvent& e);
-		void OnDestroyNotify(const XdestroyWindowEvent& e);
+		void OnCreateNotify(const XCreateWindowEvent& e);
+		void OnDestroyNotify(const XDestroyWindowEvent& e);
 		void OnReparentNotify(const XReparentEvent& e);
 		void OnMapRequest(const XMapRequestEvent& e);
 		void OnMapNotify(const XMapEvent& e);
 		void OnUnmapNotify(const XUnmapEvent& e);
-		void OnConfigureRequest(const XConfigureRequest& e);
+		void OnConfigureRequest(const XConfigureRequestEvent& e);
 		void OnConfigureNotify(const XConfigureEvent& e);
+		void OnEnterNotify(const XCrossingEvent& e);
+		void OnButtonPress(const XButtonEvent& e);
+		void OnButtonRelease(const XButtonEvent& e);
+		void OnMotionNotify(const XMotionEvent& e);
+		void OnGenericEvent(const XGenericEventCookie& cookie);
+		// sets up the passive grabs of frame: Button1 for click to focus,
+		// unless focused, which freezes the pointer until the press is
+		// replayed, and the drag buttons with --drag_modifier
+		void GrabFrameButtons(Window frame, bool focused);
+		// queues the geometry of the drag in progress on its client
+		void ApplyDrag();
+		// grabs the arrow keys for keyboard moves and resizes, with
+		// --key_modifier, and again after the keyboard mapping changes
+		void GrabKeys();
+		void OnKeyPress(const XKeyEvent& e);
+		void OnKeyRelease(const XKeyEvent& e);
+		// the bindings acting on the focused application's group
+		void OnGroupKey(const XKeyEvent& e);
+		// takes a copy, which XRefreshKeyboardMapping() wants non-const
+		void OnMappingNotify(XMappingEvent e);
+		void OnFocusIn(const XFocusChangeEvent& e);
+		void OnClientMessage(const XClientMessageEvent& e);
 
 
 		// handle to the underlying Xlib Display struct
 		Display* display_;
 		// handle to root window
 		const Window root_;
-		// maps top-level windows to their frame windows
-		::std::unordered_map<Window, Window> clients_;
+		// atoms interned at startup
+		Atoms atoms_;
+		// maps top-level windows to their client records
+		PooledMap<Window, Client> clients_;
+		// maps frames to their client records
+		PooledMap<Window, Client*> frames_;
+		// leader window to one member of its group
+		PooledMap<Window, Client*> groups_;
+		// transients whose WM_TRANSIENT_FOR window isn't managed (yet)
+		::std::unordered_multimap<Window, Client*> pending_transients_;
+		// scratch buffers for restacking
+		::std::vector<Window> group_windows_;
+		::std::vector<Client*> above_clients_;
+		// raises so far, to stamp Client::raised with
+		uint64_t raises_ = 0;
+		// something was raised this batch, so the clients kept above must be
+		// raised over it again at the commit
+		bool restack_above_ = false;
+		// clients with changes queued for the next batch commit
+		::std::vector<Window> dirty_windows_;
+		// client to activate at the next batch commit, and the request's time
+		Window pending_active_ = None;
+		Time pending_active_time_ = CurrentTime;
+		// client the pointer last entered with --focus_follows_mouse, focused
+		// at the next batch commit, so a sweep across many windows only
+		// focuses the last one
+		PendingCrossing pending_focus_;
+		// client with the input focus and the focused border
+		Window focused_ = None;
+		// server time of the latest dispatched event that carries one
+		Time last_event_time_ = CurrentTime;
+		// with --click_to_focus, a press caught by the Button1 grab froze
+		// the pointer. the next batch commit replays it to the client,
+		// after the focus and raise. replay_queued_ns_ is when the press
+		// was read
+		bool replay_pointer_ = false;
+		Time replay_time_ = CurrentTime;
+		uint64_t replay_queued_ns_ = 0;
+		// interactive move and resize, and when the first drag motion of
+		// the batch was read, zero if none
+		DragEngine drag_;
+		uint64_t drag_queued_ns_ = 0;
+		// when the event being handled was read
+		uint64_t current_queued_ns_ = 0;
+		// keycodes of the left, right, up and down arrows, zero if unmapped,
+		// and a bit for each held down
+		static const int kArrowKeys = 4;
+		KeyCode arrow_keycodes_[kArrowKeys] = {};
+		// keycodes of the group bindings, see --key_modifier
+		KeyCode close_keycode_ = 0;
+		KeyCode freeze_keycode_ = 0;
+		uint32_t keys_down_ = 0;
+		// client message type and _NET_WM_STATE bit of each handled atom
+		AtomIndex message_index_;
+		AtomIndex state_index_;
+		// _NET_SUPPORTING_WM_CHECK window, also the WM_Sn selection owner
+		Window check_window_ = None;
+		// WM_Sn for our screen
+		Atom manager_selection_ = None;
+		// cleared when we are replaced
+		bool running_ = true;
+		// deferred windows with the time they get framed anyway. the grace
+		// period only changes on config reloads, so the queue is ordered by
+		// deadline for all practical purposes
+		struct DeferredFrame {
+			Window window;
+			uint64_t deadline_ms;
+		};
+		::std::deque<DeferredFrame> deferred_;
+		// per-application rules, compiled at startup
+		WindowRules rules_;
+		// geometry remembered across application restarts
+		SessionDb session_db_;
+		// the batch being dispatched, with the time each event was read
+		struct QueuedEvent {
+			XEvent event;
+			uint64_t queued_ns;
+		};
+		::std::vector<QueuedEvent> batch_;
+		// scratch for DispatchBatch(): indices of the events dispatched
+		// after the critical ones, and the windows they hold back
+		::std::vector<size_t> bulk_;
+		PooledSet<Window> held_windows_;
+		// when poll() last returned, until the next event is dispatched
+		uint64_t woke_ns_ = 0;
+		// top-level windows queried at startup and not adopted yet
+		PooledSet<Window> adopting_;
+		// events selected on each kind of window
+		EventMasks event_masks_;
+		// set once existing windows are adopted. from then on, handling an
+		// event shouldn't allocate
+		bool steady_state_ = false;
+		// bit n set once an event of type n was reported for allocating,
+		// with --alloc_check
+		uint64_t alloc_reported_ = 0;
+		// workspace whose frames are mapped
+		int current_workspace_ = 0;
+		// workspaces advertised in _NET_NUMBER_OF_DESKTOPS, from --workspaces
+		int workspace_count_ = 1;
+		// current config snapshot. read without locking, replaced only by
+		// ReloadConfig() between batches
+		::std::unique_ptr<const Config> config_;
+		ConfigWatcher config_watcher_;
+		// set when the watcher published a new snapshot
+		bool config_ready_ = false;
+		// signalfd used to dump metrics on SIGUSR1 and the timeline on SIGUSR2
+		int signal_fd_;
+		Metrics metrics_;
+		// event loop spans, recorded with --timeline_spans
+		Timeline timeline_;
+		// reports the event loop's stack when it stalls
+		Watchdog watchdog_;
+		// binary log of the latest events, kept for post-mortems
+		FlightRecorder flight_recorder_;
+		// plugins loaded with --plugins and the services offered to them
+		pulkras_host plugin_host_;
+		PluginHost plugins_;
 		// xlib error handler. it's address is passed to xlib
 		static int OnXError(Display* display, XErrorEvent* e);
 		// xlib error handler used to determine whether another window manager
@@ -55,6 +341,10 @@ class WindowManager {
 		// whether an existing window maanger has been detected. set by OnWMDetected
 		// hence must be static
 		static bool wm_detected_;
+		// xlib error handler for selecting on the old selection owner, which
+		// may be destroyed at any moment. sets old_owner_gone_ on BadWindow
+		static int OnOldOwnerError(Display* display, XErrorEvent* e);
+		static bool old_owner_gone_;
 };
 
 #endif
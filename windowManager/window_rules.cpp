@@ -0,0 +1,387 @@
+#include "window_rules.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+using ::std::string;
+using ::std::vector;
+
+namespace {
+
+enum Key { kClassKey, kInstanceKey, kRoleKey, kTitleKey };
+
+inline void SetBit(uint64_t* bits, uint32_t i) {
+	bits[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+// whether glob matches all of s. a mismatch backtracks to the last '*'
+// only, which is enough for globs and linear for the usual ones
+bool GlobMatches(const char* glob, const char* s) {
+	const char* star = nullptr;
+	const char* resume = nullptr;
+	while (*s != '\0') {
+		if (*glob == '*') {
+			star = glob++;
+			resume = s;
+		} else if (*glob != '\0' && (*glob == '?' || *glob == *s)) {
+			glob++;
+			s++;
+		} else if (star != nullptr) {
+			glob = star + 1;
+			s = ++resume;
+		} else {
+			return false;
+		}
+	}
+	while (*glob == '*') {
+		glob++;
+	}
+	return *glob == '\0';
+}
+
+// splits a rule line into tokens at spaces and tabs, dropping the double
+// quotes around parts of a token and the comment after a '#' outside them.
+// returns false on an unterminated quote
+bool SplitTokens(const string& line, vector<string>* tokens) {
+	string token;
+	bool in_token = false;
+	bool quoted = false;
+	for (char c : line) {
+		if (quoted) {
+			if (c == '"') {
+				quoted = false;
+			} else {
+				token.push_back(c);
+			}
+			continue;
+		}
+		if (c == '#') {
+			break;
+		}
+		if (c == ' ' || c == '\t') {
+			if (in_token) {
+				tokens->push_back(::std::move(token));
+				token.clear();
+				in_token = false;
+			}
+			continue;
+		}
+		in_token = true;
+		if (c == '"') {
+			quoted = true;
+		} else {
+			token.push_back(c);
+		}
+	}
+	if (in_token) {
+		tokens->push_back(::std::move(token));
+	}
+	return !quoted;
+}
+
+// parses a non-negative int, the whole of value. returns false, leaving
+// count alone, on anything else
+bool ParseCount(const string& value, int* count) {
+	if (value.empty() || value[0] < '0' || value[0] > '9') {
+		return false;
+	}
+	char* end;
+	errno = 0;
+	const long parsed = strtol(value.c_str(), &end, 10);
+	if (*end != '\0' || errno == ERANGE || parsed > INT_MAX) {
+		return false;
+	}
+	*count = parsed;
+	return true;
+}
+
+}  // namespace
+
+WindowRules::Trie::Trie() : nodes_(1) {}
+
+void WindowRules::Trie::Insert(const string& key, uint32_t rule) {
+	uint32_t node = 0;
+	for (char c : key) {
+		uint32_t next = 0;
+		for (uint32_t child : nodes_[node].children) {
+			if (nodes_[child].label == c) {
+				next = child;
+				break;
+			}
+		}
+		if (next == 0) {
+			next = nodes_.size();
+			nodes_.emplace_back();
+			nodes_[next].label = c;
+			nodes_[node].children.push_back(next);
+			::std::sort(
+					nodes_[node].children.begin(),
+					nodes_[node].children.end(),
+					[this](uint32_t a, uint32_t b) { return nodes_[a].label < nodes_[b].label; });
+		}
+		node = next;
+	}
+	nodes_[node].rules.push_back(rule);
+}
+
+uint32_t WindowRules::Trie::Child(uint32_t node, char c) const {
+	const vector<uint32_t>& children = nodes_[node].children;
+	auto it = ::std::lower_bound(
+			children.begin(),
+			children.end(),
+			c,
+			[this](uint32_t child, char c) { return nodes_[child].label < c; });
+	return it != children.end() && nodes_[*it].label == c ? *it : 0;
+}
+
+void WindowRules::Trie::Match(const char* s, uint64_t* rule_bits) const {
+	uint32_t node = 0;
+	for (; *s != '\0'; s++) {
+		node = Child(node, *s);
+		if (node == 0) {
+			return;
+		}
+	}
+	const Node& found = nodes_[node];
+	if (!found.rule_bits.empty()) {
+		for (size_t i = 0; i < found.rule_bits.size(); i++) {
+			rule_bits[i] |= found.rule_bits[i];
+		}
+		return;
+	}
+	for (uint32_t rule : found.rules) {
+		SetBit(rule_bits, rule);
+	}
+}
+
+void WindowRules::Trie::Compile(size_t words) {
+	for (Node& node : nodes_) {
+		if (node.rules.size() <= words) {
+			continue;
+		}
+		node.rule_bits.assign(words, 0);
+		for (uint32_t rule : node.rules) {
+			SetBit(node.rule_bits.data(), rule);
+		}
+	}
+}
+
+void WindowRules::GlobSet::Add(const string& glob, uint32_t rule) {
+	// collapse runs of '*', they match the same as one
+	string tokens;
+	for (char c : glob) {
+		if (c == '*' && !tokens.empty() && tokens.back() == '*') {
+			continue;
+		}
+		tokens.push_back(c);
+	}
+	globs_.push_back({tokens, rule});
+}
+
+void WindowRules::GlobSet::Compile() {
+	for (uint32_t i = 0; i < globs_.size(); i++) {
+		// a title the glob matches contains each of its literal runs, so the
+		// longest, being the rarest, picks the candidates
+		const string& tokens = globs_[i].tokens;
+		size_t best = 0, best_length = 0;
+		for (size_t start = 0; start < tokens.size();) {
+			size_t end = start;
+			while (end < tokens.size() && tokens[end] != '*' && tokens[end] != '?') {
+				end++;
+			}
+			if (end - start > best_length) {
+				best = start;
+				best_length = end - start;
+			}
+			start = end + 1;
+		}
+		if (best_length == 0) {
+			unkeyed_.push_back(i);
+		} else {
+			literals_.Insert(tokens.substr(best, best_length), i);
+		}
+	}
+	checked_.assign(globs_.size(), 0);
+	match_count_ = 0;
+}
+
+void WindowRules::GlobSet::Check(uint32_t i, const char* s, uint64_t* rule_bits) const {
+	if (checked_[i] == match_count_) {
+		return;
+	}
+	checked_[i] = match_count_;
+	if (GlobMatches(globs_[i].tokens.c_str(), s)) {
+		SetBit(rule_bits, globs_[i].rule);
+	}
+}
+
+void WindowRules::GlobSet::Match(const char* s, uint64_t* rule_bits) const {
+	if (globs_.empty()) {
+		return;
+	}
+	// a fresh mark per call, so no glob is checked twice. on wrapping, the
+	// old marks could collide and are cleared
+	if (++match_count_ == 0) {
+		::std::fill(checked_.begin(), checked_.end(), 0);
+		match_count_ = 1;
+	}
+	for (uint32_t i : unkeyed_) {
+		Check(i, s, rule_bits);
+	}
+	literals_.ForEachSubstring(s, [this, s, rule_bits](uint32_t i) {
+		Check(i, s, rule_bits);
+	});
+}
+
+bool WindowRules::Load(const string& path) {
+	::std::ifstream in(path);
+	if (!in) {
+		return false;
+	}
+	// start over, so loading again replaces the rules rather than adding
+	// to them
+	actions_.clear();
+	class_trie_ = Trie();
+	instance_trie_ = Trie();
+	role_trie_ = Trie();
+	titles_ = GlobSet();
+
+	string line;
+	int line_number = 0;
+	vector<vector<::std::pair<Key, string>>> keys;
+	while (::std::getline(in, line)) {
+		line_number++;
+		vector<string> tokens;
+		bool ok = SplitTokens(line, &tokens);
+		Actions actions;
+		vector<::std::pair<Key, string>> rule_keys;
+		bool has_action = false;
+		for (const string& token : tokens) {
+			const size_t eq = token.find('=');
+			const string name = token.substr(0, eq);
+			const string value = eq == string::npos ? string() : token.substr(eq + 1);
+			if (name == "class") {
+				rule_keys.emplace_back(kClassKey, value);
+			} else if (name == "instance") {
+				rule_keys.emplace_back(kInstanceKey, value);
+			} else if (name == "role") {
+				rule_keys.emplace_back(kRoleKey, value);
+			} else if (name == "title") {
+				rule_keys.emplace_back(kTitleKey, value);
+			} else if (name == "workspace") {
+				ok &= ParseCount(value, &actions.workspace);
+				has_action = true;
+			} else if (name == "border") {
+				ok &= ParseCount(value, &actions.border_width);
+				has_action = true;
+			} else if (name == "placement") {
+				actions.has_placement = true;
+				has_action = true;
+				if (value == "center") {
+					actions.placement = Placement::kCenter;
+				} else if (value == "pointer") {
+					actions.placement = Placement::kPointer;
+				} else if (value == "client") {
+					actions.placement = Placement::kClient;
+				} else {
+					ok = false;
+				}
+			} else if (name == "noframe") {
+				actions.no_frame = true;
+				has_action = true;
+			} else {
+				ok = false;
+			}
+		}
+
+		if (rule_keys.empty() && !has_action) {
+			continue;
+		}
+		if (!ok || !has_action) {
+			LOG(WARNING) << path << ":" << line_number << ": ignoring malformed rule";
+			continue;
+		}
+		actions_.push_back(actions);
+		keys.push_back(::std::move(rule_keys));
+	}
+
+	// compile the rule set
+	words_ = (actions_.size() + 63) / 64;
+	for (int k = 0; k < kNumKeys; k++) {
+		unconstrained_[k].assign(words_, 0);
+		hits_[k].assign(words_, 0);
+	}
+	for (uint32_t rule = 0; rule < keys.size(); rule++) {
+		bool constrained[kNumKeys] = {};
+		for (const auto& key : keys[rule]) {
+			constrained[key.first] = true;
+			switch (key.first) {
+				case kClassKey:
+					class_trie_.Insert(key.second, rule);
+					break;
+				case kInstanceKey:
+					instance_trie_.Insert(key.second, rule);
+					break;
+				case kRoleKey:
+					role_trie_.Insert(key.second, rule);
+					break;
+				case kTitleKey:
+					titles_.Add(key.second, rule);
+					break;
+			}
+		}
+		for (int k = 0; k < kNumKeys; k++) {
+			if (!constrained[k]) {
+				SetBit(unconstrained_[k].data(), rule);
+			}
+		}
+	}
+	class_trie_.Compile(words_);
+	instance_trie_.Compile(words_);
+	role_trie_.Compile(words_);
+	titles_.Compile();
+
+	LOG(INFO) << "loaded " << actions_.size() << " window rules from " << path;
+	return true;
+}
+
+RuleResult WindowRules::Match(const RuleSubject& subject) const {
+	RuleResult result;
+	if (actions_.empty()) {
+		return result;
+	}
+
+	for (int k = 0; k < kNumKeys; k++) {
+		::std::copy(unconstrained_[k].begin(), unconstrained_[k].end(), hits_[k].begin());
+	}
+	class_trie_.Match(subject.res_class, hits_[kClassKey].data());
+	instance_trie_.Match(subject.res_name, hits_[kInstanceKey].data());
+	role_trie_.Match(subject.role, hits_[kRoleKey].data());
+	titles_.Match(subject.title, hits_[kTitleKey].data());
+
+	// a rule matches when every key is either unconstrained or hit. apply
+	// matches in file order
+	for (size_t i = 0; i < words_; i++) {
+		uint64_t matched = hits_[kClassKey][i] & hits_[kInstanceKey][i] &
+			hits_[kRoleKey][i] & hits_[kTitleKey][i];
+		while (matched) {
+			const int bit = __builtin_ctzll(matched);
+			matched &= matched - 1;
+			const Actions& actions = actions_[i * 64 + bit];
+			if (actions.workspace >= 0) {
+				result.workspace = actions.workspace;
+			}
+			if (actions.border_width >= 0) {
+				result.border_width = actions.border_width;
+			}
+			if (actions.has_placement) {
+				result.placement = actions.placement;
+			}
+			result.no_frame |= actions.no_frame;
+			result.num_matched++;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,165 @@
+#ifndef WINDOW_RULES_HPP
+#define WINDOW_RULES_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// where a newly framed window is placed
+enum class Placement : uint8_t {
+	// keep the position requested by the client
+	kClient,
+	// center on the screen
+	kCenter,
+	// center under the pointer
+	kPointer,
+};
+
+// the merged outcome of all rules matching a window. fields no rule set
+// keep their "unset" values
+struct RuleResult {
+	int workspace = -1;
+	int border_width = -1;
+	Placement placement = Placement::kClient;
+	bool no_frame = false;
+	// number of rules that matched
+	unsigned int num_matched = 0;
+};
+
+// the strings a rule can match on, as cached in the client record
+struct RuleSubject {
+	const char* res_class;
+	const char* res_name;
+	const char* role;
+	const char* title;
+};
+
+// per-application rules keyed on WM_CLASS, WM_WINDOW_ROLE and title.
+//
+// the rule file holds one rule per line, made of key=value tokens:
+//
+//   class=Firefox instance=Navigator title=*YouTube* workspace=2 placement=center
+//   class=mpv border=0
+//   title="Picture in picture" placement=pointer
+//   role=pop-up noframe
+//
+// match keys are class, instance and role (exact) and title (glob with * and
+// ?, anchored at both ends). action keys are workspace, border, placement
+// (client|center|pointer) and noframe. a value in double quotes may hold
+// spaces and '#'; there are no escapes, so it can't hold '"'. outside quotes
+// '#' starts a comment. workspace and border take non-negative integers, and
+// a line with a bad value or an unterminated quote is skipped. when several
+// rules match, they are applied in file order so later rules override
+// earlier ones.
+//
+// the rule set is compiled at load time: class, instance and role go into
+// tries, and title globs are indexed by their longest literal. matching is a
+// walk over each cached string plus a check of the globs whose literal
+// occurs in the title, so its cost doesn't grow with the number of rules
+// beyond a bitset word per 64 rules, and it doesn't allocate
+class WindowRules {
+	public:
+		// loads and compiles the rules in path, replacing those loaded
+		// before. returns false, keeping them, if the file can't be read;
+		// malformed lines are logged and skipped
+		bool Load(const ::std::string& path);
+
+		// matches subject against all rules
+		RuleResult Match(const RuleSubject& subject) const;
+
+		size_t size() const { return actions_.size(); }
+
+	private:
+		struct Actions {
+			int workspace = -1;
+			int border_width = -1;
+			bool has_placement = false;
+			Placement placement = Placement::kClient;
+			bool no_frame = false;
+		};
+
+		// exact string matcher. each terminal node lists the rules keyed on
+		// the string spelled by the path to it
+		class Trie {
+			public:
+				Trie();
+				void Insert(const ::std::string& key, uint32_t rule);
+				// turns long rule lists into bitsets of words words, so a key
+				// shared by many rules costs a pass over the bitset rather
+				// than a bit per rule. call after the last Insert()
+				void Compile(size_t words);
+				// sets the bits of rules keyed on s
+				void Match(const char* s, uint64_t* rule_bits) const;
+				// calls f with each rule keyed on a substring of s, once per
+				// occurrence. costs O(length of s times the longest key)
+				template <typename F>
+				void ForEachSubstring(const char* s, F f) const {
+					for (; *s != '\0'; s++) {
+						uint32_t node = 0;
+						for (const char* c = s; *c != '\0' && (node = Child(node, *c)) != 0; c++) {
+							for (uint32_t rule : nodes_[node].rules) {
+								f(rule);
+							}
+						}
+					}
+				}
+
+			private:
+				// the child of node labeled c, 0 if there is none
+				uint32_t Child(uint32_t node, char c) const;
+
+				struct Node {
+					// children, sorted by label after Insert()
+					::std::vector<uint32_t> children;
+					char label = 0;
+					::std::vector<uint32_t> rules;
+					// rules as a bitset, when that is shorter than the list
+					::std::vector<uint64_t> rule_bits;
+				};
+				::std::vector<Node> nodes_;
+		};
+
+		// title globs, indexed by their longest literal run. matching walks
+		// the title once through the index and checks only the globs whose
+		// literal occurs in it. globs without a literal, like "*", are
+		// checked against every title
+		class GlobSet {
+			public:
+				void Add(const ::std::string& glob, uint32_t rule);
+				// builds the index. must be called after the last Add()
+				void Compile();
+				// sets the bits of rules whose glob matches all of s
+				void Match(const char* s, uint64_t* rule_bits) const;
+
+			private:
+				struct Glob {
+					::std::string tokens;
+					uint32_t rule;
+				};
+				// checks glob i against s, once per Match() call
+				void Check(uint32_t i, const char* s, uint64_t* rule_bits) const;
+
+				::std::vector<Glob> globs_;
+				// glob indices keyed on their longest literal
+				Trie literals_;
+				// globs made of wildcards only
+				::std::vector<uint32_t> unkeyed_;
+				// per glob, the Match() call that last checked it
+				mutable ::std::vector<uint32_t> checked_;
+				mutable uint32_t match_count_ = 0;
+		};
+
+		// number of match keys
+		static const int kNumKeys = 4;
+
+		::std::vector<Actions> actions_;
+		size_t words_ = 0;
+		Trie class_trie_, instance_trie_, role_trie_;
+		GlobSet titles_;
+		// per key, the rules that don't constrain it
+		::std::vector<uint64_t> unconstrained_[kNumKeys];
+		// scratch bitsets, sized at load time
+		mutable ::std::vector<uint64_t> hits_[kNumKeys];
+};
+
+#endif